@@ -145,6 +145,30 @@ OD_entry_t *OD_find(OD_t *od, uint16_t index) {
         return NULL;
     }
 
+#if OD_INDEX_PAGES > 0
+    if (od->index != NULL) {
+        const uint8_t p = od->index->page[index >> 8];
+        if (p == OD_INDEX_NONE) {
+            return NULL;
+        }
+
+        const OD_indexPage_t *page = &od->index->pages[p];
+        const uint8_t word = (uint8_t)(index >> 5) & 0x07U;
+        const uint32_t bit = 1UL << (index & 0x1FU);
+        if ((page->map[word] & bit) == 0) {
+            return NULL;
+        }
+
+        /* set bits below the entry in its word, SWAR population count */
+        uint32_t below = page->map[word] & (bit - 1U);
+        below = below - ((below >> 1) & 0x55555555UL);
+        below = (below & 0x33333333UL) + ((below >> 2) & 0x33333333UL);
+        below = (uint32_t)(((below + (below >> 4)) & 0x0F0F0F0FUL) * 0x01010101UL) >> 24;
+
+        return &od->list[page->first + page->rank[word] + below];
+    }
+#endif
+
     uint16_t min = 0;
     uint16_t max = od->size - 1;
 
@@ -178,6 +202,61 @@ OD_entry_t *OD_find(OD_t *od, uint16_t index) {
     return NULL;  /* entry does not exist in OD */
 }
 
+#if OD_INDEX_PAGES > 0
+/******************************************************************************/
+bool_t OD_buildIndex(OD_t *od, OD_index_t *index) {
+    uint16_t i;
+    uint8_t pagesUsed = 0;
+
+    if (od == NULL || index == NULL) {
+        return false;
+    }
+    od->index = NULL;
+    memset(index->page, OD_INDEX_NONE, sizeof(index->page));
+
+    for (i = 0; i < od->size; i++) {
+        const uint16_t odIndex = od->list[i].index;
+        const uint8_t high = (uint8_t)(odIndex >> 8);
+        OD_indexPage_t *page;
+
+        /* OD_find() and the rank both rely on the order */
+        if (i > 0 && odIndex <= od->list[i - 1].index) {
+            return false;
+        }
+
+        if (index->page[high] == OD_INDEX_NONE) {
+            if (pagesUsed >= OD_INDEX_PAGES) {
+                return false;
+            }
+            index->page[high] = pagesUsed;
+            page = &index->pages[pagesUsed++];
+            memset(page, 0, sizeof(*page));
+            page->first = i;
+        }
+        page = &index->pages[index->page[high]];
+        page->map[(odIndex >> 5) & 0x07U] |= 1UL << (odIndex & 0x1FU);
+    }
+
+    /* entries before each map word */
+    for (i = 0; i < pagesUsed; i++) {
+        OD_indexPage_t *page = &index->pages[i];
+        uint8_t rank = 0;
+        uint8_t word;
+        for (word = 0; word < 8U; word++) {
+            uint32_t bits = page->map[word];
+            page->rank[word] = rank;
+            while (bits != 0) {
+                bits &= bits - 1U;
+                rank++;
+            }
+        }
+    }
+
+    od->index = index;
+    return true;
+}
+#endif /* OD_INDEX_PAGES > 0 */
+
 /******************************************************************************/
 ODR_t OD_getSub(const OD_entry_t *entry, uint8_t subIndex,
                 OD_IO_t *io, bool_t odOrig)
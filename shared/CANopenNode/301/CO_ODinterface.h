@@ -59,6 +59,13 @@ typedef uint8_t OD_attr_t;
 #define OD_FLAGS_PDO_SIZE 4
 #endif
 
+#ifndef OD_INDEX_PAGES
+/** Number of index pages (indexes sharing their high byte) an
+ * @ref OD_index_t can hold, from 0 to 255. 0 disables the index and OD_find()
+ * always uses binary search. */
+#define OD_INDEX_PAGES 0
+#endif
+
 #ifndef CO_PROGMEM
 /** Modifier for OD objects. This is large amount of data and is specified in
  * Object Dictionary (OD.c file usually) */
@@ -367,6 +374,39 @@ typedef struct {
 } OD_entry_t;
 
 
+#if OD_INDEX_PAGES > 0 || defined CO_DOXYGEN
+/** @ref OD_index_t page for an index high byte without entries */
+#define OD_INDEX_NONE 0xFFU
+
+/**
+ * Entries of one index page, the 256 indexes sharing their high byte.
+ */
+typedef struct {
+    /** One bit per index low byte, set if the entry exists */
+    uint32_t map[8];
+    /** Entries in the page before each word of map */
+    uint8_t rank[8];
+    /** Position of the first entry of the page in the list */
+    uint16_t first;
+} OD_indexPage_t;
+
+/**
+ * Direct lookup table for @ref OD_find(), built by @ref OD_buildIndex().
+ *
+ * Two levels keyed by index: the high byte selects a page, the low byte a
+ * bit in its map. The position in the list is the page's first entry plus
+ * the set bits before it. This takes 256 bytes plus 44 bytes per used page,
+ * a few bytes per entry for a typical Object Dictionary.
+ */
+typedef struct {
+    /** Page by index high byte, @ref OD_INDEX_NONE if the page is empty */
+    uint8_t page[256];
+    /** Used pages */
+    OD_indexPage_t pages[OD_INDEX_PAGES];
+} OD_index_t;
+#endif
+
+
 /**
  * Object Dictionary
  */
@@ -375,6 +415,11 @@ typedef struct {
     uint16_t size;
     /** List OD entries (table of contents), ordered by index */
     OD_entry_t *list;
+#if OD_INDEX_PAGES > 0 || defined CO_DOXYGEN
+    /** Lookup table set by @ref OD_buildIndex(), NULL for binary search. The
+     * generated initializer leaves it NULL. */
+    const OD_index_t *index;
+#endif
 } OD_t;
 
 
@@ -415,6 +460,25 @@ ODR_t OD_writeOriginal(OD_stream_t *stream, const void *buf,
 OD_entry_t *OD_find(OD_t *od, uint16_t index);
 
 
+#if OD_INDEX_PAGES > 0 || defined CO_DOXYGEN
+/**
+ * Build direct lookup table for @ref OD_find()
+ *
+ * Called once by the application, before CANopen is initialized, with storage
+ * that lives as long as the Object Dictionary, e.g.
+ * `static OD_index_t OD_index; OD_buildIndex(OD, &OD_index);`. The index
+ * belongs to that one Object Dictionary.
+ *
+ * @param od Object Dictionary
+ * @param index Storage for the table
+ *
+ * @return true on success. false if the list is not ordered by index or uses
+ * more than @ref OD_INDEX_PAGES pages, OD_find() then keeps binary search.
+ */
+bool_t OD_buildIndex(OD_t *od, OD_index_t *index);
+#endif
+
+
 /**
  * Find sub-object with specified sub-index on OD entry returned by OD_find.
  * Function populates io structure with sub-object data.
@@ -149,6 +149,64 @@ static ODR_t PDOconfigMap(CO_PDO_common_t *PDO,
     return ODR_OK;
 }
 
+#if CO_PDO_COPY_PLAN
+/*
+ * Compile copy plan for the mapped entries, see CO_PDO_segment_t
+ *
+ * @param PDO This object, mapping must be valid.
+ * @param isRPDO True for RPDO and false for TPDO.
+ */
+static void PDO_compilePlan(CO_PDO_common_t *PDO, bool_t isRPDO) {
+    CO_PDO_segment_t *segment = NULL;
+    uint8_t pdoOffset = 0;
+
+    PDO->segmentsCount = 0;
+    for (uint8_t i = 0; i < PDO->mappedObjectsCount; i++) {
+        OD_IO_t *OD_IO = &PDO->OD_IO[i];
+        OD_stream_t *stream = &OD_IO->stream;
+        uint8_t *dataOrig = (uint8_t *)stream->dataOrig;
+        uint8_t mappedLength = (uint8_t) stream->dataOffset;
+        OD_size_t ODdataLength = stream->dataLength;
+        if (ODdataLength > CO_PDO_MAX_SIZE)
+            ODdataLength = CO_PDO_MAX_SIZE;
+
+        /* Direct copy must give the same result as OD_readOriginal() or
+         * OD_writeOriginal(). RPDO writes zeroes to the bytes of the variable,
+         * which are not mapped, so such entries are left to OD_IO. */
+        bool_t direct = dataOrig != NULL;
+        if (isRPDO) {
+            direct = direct && OD_IO->write == OD_writeOriginal
+                     && ODdataLength == mappedLength;
+        }
+        else {
+            direct = direct && OD_IO->read == OD_readOriginal;
+ #if OD_FLAGS_PDO_SIZE > 0
+            direct = direct && PDO->flagPDObyte[i] == NULL;
+ #endif
+        }
+ #ifdef CO_BIG_ENDIAN
+        if ((stream->attribute & ODA_MB) != 0) {
+            direct = false;
+        }
+ #endif
+
+        if (direct && segment != NULL && segment->dataOrig != NULL
+            && segment->dataOrig + segment->length == dataOrig
+        ) {
+            segment->length += mappedLength;
+        }
+        else {
+            segment = &PDO->segments[PDO->segmentsCount++];
+            segment->dataOrig = direct ? dataOrig : NULL;
+            segment->pdoOffset = pdoOffset;
+            segment->length = mappedLength;
+            segment->mapIndex = i;
+        }
+        pdoOffset += mappedLength;
+    }
+}
+#endif /* CO_PDO_COPY_PLAN */
+
 /*
  * Initialize PDO mapping parameters
  *
@@ -217,6 +275,9 @@ static CO_ReturnError_t PDO_initMapping(CO_PDO_common_t *PDO,
     if (*erroneousMap == 0) {
         PDO->dataLength = (CO_PDO_size_t)pdoDataLength;
         PDO->mappedObjectsCount = mappedObjectsCount;
+#if CO_PDO_COPY_PLAN
+        PDO_compilePlan(PDO, isRPDO);
+#endif
     }
 
     return CO_ERROR_NO;
@@ -277,6 +338,9 @@ static ODR_t OD_write_PDO_mapping(OD_stream_t *stream, const void *buf,
         /* success, update PDO */
         PDO->dataLength = (CO_PDO_size_t)pdoDataLength;
         PDO->mappedObjectsCount = mappedObjectsCount;
+ #if CO_PDO_COPY_PLAN
+        PDO_compilePlan(PDO, PDO->isRPDO);
+ #endif
     }
     else {
         ODR_t odRet = PDOconfigMap(PDO, CO_getUint32(buf), stream->subIndex-1,
@@ -491,6 +555,9 @@ static void CO_PDO_receive(void *object, void *msg) {
 
             /* copy data into appropriate buffer and set 'new message' flag */
             memcpy(RPDO->CANrxData[bufNo], data,sizeof(RPDO->CANrxData[bufNo]));
+#ifdef CO_CANrxMsg_readTimestamp
+            RPDO->CANrxTimestamp_us[bufNo] = CO_CANrxMsg_readTimestamp(msg);
+#endif
             CO_FLAG_SET(RPDO->CANrxNew[bufNo]);
 
 #if (CO_CONFIG_PDO) & CO_CONFIG_FLAG_CALLBACK_PRE
@@ -772,6 +839,58 @@ void CO_RPDO_initCallbackPre(CO_RPDO_t *RPDO,
 #endif
 
 
+#if (CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS
+/*
+ * Write one mapped entry of the received RPDO into the OD variable
+ *
+ * @param OD_IO Mapped entry.
+ * @param dataRPDO Its data inside the RPDO.
+ */
+static void CO_RPDO_writeMapped(OD_IO_t *OD_IO, uint8_t *dataRPDO) {
+    /* get mappedLength from temporary storage */
+    OD_size_t *dataOffset = &OD_IO->stream.dataOffset;
+    uint8_t mappedLength = (uint8_t) (*dataOffset);
+
+    /* length of OD variable may be larger than mappedLength */
+    OD_size_t ODdataLength = OD_IO->stream.dataLength;
+    if (ODdataLength > CO_PDO_MAX_SIZE)
+        ODdataLength = CO_PDO_MAX_SIZE;
+
+    /* Prepare data for writing into OD variable. If mappedLength
+     * is smaller than ODdataLength, then use auxiliary buffer */
+    uint8_t buf[CO_PDO_MAX_SIZE];
+    uint8_t *dataOD;
+    if (ODdataLength > mappedLength) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, dataRPDO, mappedLength);
+        dataOD = buf;
+    }
+    else {
+        dataOD = dataRPDO;
+    }
+
+    /* swap multibyte data if big-endian */
+ #ifdef CO_BIG_ENDIAN
+    if ((OD_IO->stream.attribute & ODA_MB) != 0) {
+        uint8_t *lo = dataOD;
+        uint8_t *hi = dataOD + ODdataLength - 1;
+        while (lo < hi) {
+            uint8_t swap = *lo;
+            *lo++ = *hi;
+            *hi-- = swap;
+        }
+    }
+ #endif
+
+    /* Set stream.dataOffset to zero, perform OD_IO.write()
+     * and store mappedLength back to stream.dataOffset */
+    *dataOffset = 0;
+    OD_size_t countWritten;
+    OD_IO->write(&OD_IO->stream, dataOD, ODdataLength, &countWritten);
+    *dataOffset = mappedLength;
+}
+#endif /* (CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS */
+
 /******************************************************************************/
 void CO_RPDO_process(CO_RPDO_t *RPDO,
 #if (CO_CONFIG_PDO) & CO_CONFIG_RPDO_TIMERS_ENABLE
@@ -818,54 +937,25 @@ void CO_RPDO_process(CO_RPDO_t *RPDO,
             CO_FLAG_CLEAR(RPDO->CANrxNew[bufNo]);
 
 #if (CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS
-            for (uint8_t i = 0; i < PDO->mappedObjectsCount; i++) {
-                OD_IO_t *OD_IO = &PDO->OD_IO[i];
-
-                /* get mappedLength from temporary storage */
-                OD_size_t *dataOffset = &OD_IO->stream.dataOffset;
-                uint8_t mappedLength = (uint8_t) (*dataOffset);
-
-                /* length of OD variable may be larger than mappedLength */
-                OD_size_t ODdataLength = OD_IO->stream.dataLength;
-                if (ODdataLength > CO_PDO_MAX_SIZE)
-                    ODdataLength = CO_PDO_MAX_SIZE;
-
-                /* Prepare data for writing into OD variable. If mappedLength
-                 * is smaller than ODdataLength, then use auxiliary buffer */
-                uint8_t buf[CO_PDO_MAX_SIZE];
-                uint8_t *dataOD;
-                if (ODdataLength > mappedLength) {
-                    memset(buf, 0, sizeof(buf));
-                    memcpy(buf, dataRPDO, mappedLength);
-                    dataOD = buf;
+ #if CO_PDO_COPY_PLAN
+            for (uint8_t i = 0; i < PDO->segmentsCount; i++) {
+                const CO_PDO_segment_t *segment = &PDO->segments[i];
+                if (segment->dataOrig != NULL) {
+                    memcpy(segment->dataOrig, &dataRPDO[segment->pdoOffset],
+                           segment->length);
                 }
                 else {
-                    dataOD = dataRPDO;
+                    CO_RPDO_writeMapped(&PDO->OD_IO[segment->mapIndex],
+                                        &dataRPDO[segment->pdoOffset]);
                 }
-
-                /* swap multibyte data if big-endian */
- #ifdef CO_BIG_ENDIAN
-                if ((OD_IO->stream.attribute & ODA_MB) != 0) {
-                    uint8_t *lo = dataOD;
-                    uint8_t *hi = dataOD + ODdataLength - 1;
-                    while (lo < hi) {
-                        uint8_t swap = *lo;
-                        *lo++ = *hi;
-                        *hi-- = swap;
-                    }
-                }
- #endif
-
-                /* Set stream.dataOffset to zero, perform OD_IO.write()
-                 * and store mappedLength back to stream.dataOffset */
-                *dataOffset = 0;
-                OD_size_t countWritten;
-                OD_IO->write(&OD_IO->stream, dataOD,
-                             ODdataLength, &countWritten);
-                *dataOffset = mappedLength;
-
-                dataRPDO += mappedLength;
             }
+ #else
+            for (uint8_t i = 0; i < PDO->mappedObjectsCount; i++) {
+                OD_IO_t *OD_IO = &PDO->OD_IO[i];
+                CO_RPDO_writeMapped(OD_IO, dataRPDO);
+                dataRPDO += (uint8_t) OD_IO->stream.dataOffset;
+            }
+ #endif
 
 #else
             for (uint8_t i = 0; i < PDO->dataLength; i++) {
@@ -1213,6 +1303,62 @@ CO_ReturnError_t CO_TPDO_init(CO_TPDO_t *TPDO,
 }
 
 
+#if (CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS
+/*
+ * Read one mapped entry of the TPDO from the OD variable
+ *
+ * @param OD_IO Mapped entry.
+ * @param dataTPDO Its data inside the TPDO.
+ */
+static void CO_TPDO_readMapped(OD_IO_t *OD_IO, uint8_t *dataTPDO) {
+    OD_stream_t *stream = &OD_IO->stream;
+
+    /* get mappedLength from temporary storage */
+    uint8_t mappedLength = (uint8_t) stream->dataOffset;
+
+    /* length of OD variable may be larger than mappedLength */
+    OD_size_t ODdataLength = stream->dataLength;
+    if (ODdataLength > CO_PDO_MAX_SIZE)
+        ODdataLength = CO_PDO_MAX_SIZE;
+
+    /* If mappedLength is smaller than ODdataLength, use auxiliary buffer */
+    uint8_t buf[CO_PDO_MAX_SIZE];
+    uint8_t *dataTPDOCopy;
+    if (ODdataLength > mappedLength) {
+        memset(buf, 0, sizeof(buf));
+        dataTPDOCopy = buf;
+    }
+    else {
+        dataTPDOCopy = dataTPDO;
+    }
+
+    /* Set stream.dataOffset to zero, perform OD_IO.read()
+     * and store mappedLength back to stream.dataOffset */
+    stream->dataOffset= 0;
+    OD_size_t countRd;
+    OD_IO->read(stream, dataTPDOCopy, ODdataLength, &countRd);
+    stream->dataOffset = mappedLength;
+
+    /* swap multibyte data if big-endian */
+ #ifdef CO_BIG_ENDIAN
+    if ((stream->attribute & ODA_MB) != 0) {
+        uint8_t *lo = dataTPDOCopy;
+        uint8_t *hi = dataTPDOCopy + ODdataLength - 1;
+        while (lo < hi) {
+            uint8_t swap = *lo;
+            *lo++ = *hi;
+            *hi-- = swap;
+        }
+    }
+ #endif
+
+    /* If auxiliary buffer, copy it to the TPDO */
+    if (ODdataLength > mappedLength) {
+        memcpy(dataTPDO, buf, mappedLength);
+    }
+}
+#endif /* (CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS */
+
 /*
  * Send TPDO message.
  *
@@ -1233,64 +1379,41 @@ static CO_ReturnError_t CO_TPDOsend(CO_TPDO_t *TPDO) {
 #endif
 
 #if (CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS
-    for (uint8_t i = 0; i < PDO->mappedObjectsCount; i++) {
-        OD_IO_t *OD_IO = &PDO->OD_IO[i];
-        OD_stream_t *stream = &OD_IO->stream;
-
-        /* get mappedLength from temporary storage */
-        uint8_t mappedLength = (uint8_t) stream->dataOffset;
-
-        /* length of OD variable may be larger than mappedLength */
-        OD_size_t ODdataLength = stream->dataLength;
-        if (ODdataLength > CO_PDO_MAX_SIZE)
-            ODdataLength = CO_PDO_MAX_SIZE;
-
-        /* If mappedLength is smaller than ODdataLength, use auxiliary buffer */
-        uint8_t buf[CO_PDO_MAX_SIZE];
-        uint8_t *dataTPDOCopy;
-        if (ODdataLength > mappedLength) {
-            memset(buf, 0, sizeof(buf));
-            dataTPDOCopy = buf;
-        }
-        else {
-            dataTPDOCopy = dataTPDO;
-        }
-
-        /* Set stream.dataOffset to zero, perform OD_IO.read()
-         * and store mappedLength back to stream.dataOffset */
-        stream->dataOffset= 0;
-        OD_size_t countRd;
-        OD_IO->read(stream, dataTPDOCopy, ODdataLength, &countRd);
-        stream->dataOffset = mappedLength;
-
-        /* swap multibyte data if big-endian */
- #ifdef CO_BIG_ENDIAN
-        if ((stream->attribute & ODA_MB) != 0) {
-            uint8_t *lo = dataOD;
-            uint8_t *hi = dataOD + ODdataLength - 1;
-            while (lo < hi) {
-                uint8_t swap = *lo;
-                *lo++ = *hi;
-                *hi-- = swap;
-            }
+ #if CO_PDO_COPY_PLAN
+    for (uint8_t i = 0; i < PDO->segmentsCount; i++) {
+        const CO_PDO_segment_t *segment = &PDO->segments[i];
+        if (segment->dataOrig != NULL) {
+            memcpy(&dataTPDO[segment->pdoOffset], segment->dataOrig,
+                   segment->length);
+            continue;
         }
- #endif
+        CO_TPDO_readMapped(&PDO->OD_IO[segment->mapIndex],
+                           &dataTPDO[segment->pdoOffset]);
 
-        /* If auxiliary buffer, copy it to the TPDO */
-        if (ODdataLength > mappedLength) {
-            memcpy(dataTPDO, buf, mappedLength);
+        /* In event driven TPDO indicate transmission of OD variable */
+  #if OD_FLAGS_PDO_SIZE > 0
+        uint8_t *flagPDObyte = PDO->flagPDObyte[segment->mapIndex];
+        if (flagPDObyte != NULL && eventDriven) {
+           *flagPDObyte |= PDO->flagPDObitmask[segment->mapIndex];
         }
+  #endif
+    }
+ #else
+    for (uint8_t i = 0; i < PDO->mappedObjectsCount; i++) {
+        OD_IO_t *OD_IO = &PDO->OD_IO[i];
+        CO_TPDO_readMapped(OD_IO, dataTPDO);
 
         /* In event driven TPDO indicate transmission of OD variable */
- #if OD_FLAGS_PDO_SIZE > 0
+  #if OD_FLAGS_PDO_SIZE > 0
         uint8_t *flagPDObyte = PDO->flagPDObyte[i];
         if (flagPDObyte != NULL && eventDriven) {
            *flagPDObyte |= PDO->flagPDObitmask[i];
         }
- #endif
+  #endif
 
-        dataTPDO += mappedLength;
+        dataTPDO += (uint8_t) OD_IO->stream.dataOffset;
     }
+ #endif
 #else
     for (uint8_t i = 0; i < PDO->dataLength; i++) {
         dataTPDO[i] = *PDO->mapPointer[i];
@@ -73,6 +73,8 @@ extern "C" {
  *    simplified @ref CO_CONFIG_PDO option, where instead of read()/write()
  *    access, PDO data are copied directly to/from memory locations of
  *    OD variables.
+ *  - Mapped entries without OD extension are copied directly with memcpy, in
+ *    as few segments as their memory layout allows, see @ref CO_PDO_COPY_PLAN.
  *  - After RPDO is received from CAN bus, its data are copied to internal
  *    buffer (inside fast CAN receive interrupt). Function CO_RPDO_process()
  *    (called by application) copies data to the mapped objects in the Object
@@ -144,6 +146,13 @@ extern "C" {
 #define CO_PDO_MAX_MAPPED_ENTRIES 8
 #endif
 
+/** Copy plan for mapped entries in plain OD variables, 1 to enable. Used with
+ * @ref CO_CONFIG_PDO_OD_IO_ACCESS, may be 0 to preserve RAM usage. See
+ * @ref CO_PDO_segment_t. */
+#ifndef CO_PDO_COPY_PLAN
+#define CO_PDO_COPY_PLAN 1
+#endif
+
 /** Number of CANopen RPDO objects, which uses default CAN indentifiers.
  * By default first four RPDOs have pre-defined CAN identifiers, which depends
  * on node-id. This constant may be set to 0 to disable functionality or set
@@ -183,6 +192,29 @@ typedef enum {
     (device profile and application profile specific) */
 } CO_PDO_transmissionTypes_t;
 
+#if (((CO_CONFIG_PDO) & CO_CONFIG_PDO_OD_IO_ACCESS) && CO_PDO_COPY_PLAN) \
+    || defined CO_DOXYGEN
+/**
+ * Segment of the PDO copy plan.
+ *
+ * Plan is compiled, when mapping is set. Mapped entries without OD extension
+ * are copied directly from/to their original location with memcpy and
+ * neighbours, which are adjacent in memory, are merged into single segment.
+ * Other entries keep a segment each, which is processed by OD_IO read()/write()
+ * as without the plan.
+ */
+typedef struct {
+    /** Original location of the data, NULL for entry accessed via OD_IO */
+    uint8_t *dataOrig;
+    /** Position of the segment inside PDO data */
+    uint8_t pdoOffset;
+    /** Number of bytes to copy, if dataOrig is set */
+    uint8_t length;
+    /** Index of OD_IO to use, if dataOrig is NULL */
+    uint8_t mapIndex;
+} CO_PDO_segment_t;
+#endif
+
 /**
  * PDO object, common properties
  */
@@ -211,6 +243,12 @@ typedef struct {
     /** Bitmask for the flagPDObyte */
     uint8_t flagPDObitmask[CO_PDO_MAX_MAPPED_ENTRIES];
   #endif
+  #if CO_PDO_COPY_PLAN || defined CO_DOXYGEN
+    /** Copy plan for mapped entries, see @ref CO_PDO_segment_t */
+    CO_PDO_segment_t segments[CO_PDO_MAX_MAPPED_ENTRIES];
+    /** Number of used segments */
+    uint8_t segmentsCount;
+  #endif
 #else
     /* Pointers to data objects inside OD, where PDO will be copied */
     uint8_t *mapPointer[CO_PDO_MAX_SIZE];
@@ -262,6 +300,11 @@ typedef struct {
     volatile void *CANrxNew[CO_RPDO_CAN_BUFFERS_COUNT];
     /** CO_PDO_MAX_SIZE data bytes of the received message. */
     uint8_t CANrxData[CO_RPDO_CAN_BUFFERS_COUNT][CO_PDO_MAX_SIZE];
+#if defined CO_CANrxMsg_readTimestamp || defined CO_DOXYGEN
+    /** Reception time of the message in each buffer, see
+     * CO_CANrxMsg_readTimestamp() */
+    uint64_t CANrxTimestamp_us[CO_RPDO_CAN_BUFFERS_COUNT];
+#endif
     /** Indication of RPDO length errors, use with CO_PDO_receiveErrors_t */
     uint8_t receiveError;
 #if ((CO_CONFIG_PDO) & CO_CONFIG_PDO_SYNC_ENABLE) || defined CO_DOXYGEN
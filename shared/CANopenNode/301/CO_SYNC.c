@@ -61,6 +61,9 @@ static void CO_SYNC_receive(void *object, void *msg) {
     if (syncReceived) {
         /* toggle PDO receive buffer */
         SYNC->CANrxToggle = SYNC->CANrxToggle ? false : true;
+#ifdef CO_CANrxMsg_readTimestamp
+        SYNC->timestamp_us = CO_CANrxMsg_readTimestamp(msg);
+#endif
 
         CO_FLAG_SET(SYNC->CANrxNew);
 
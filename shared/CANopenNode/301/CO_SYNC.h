@@ -87,6 +87,11 @@ typedef struct {
     uint8_t receiveError;
     /** Variable toggles, if new SYNC message received from CAN bus */
     bool_t CANrxToggle;
+#if defined CO_CANrxMsg_readTimestamp || defined CO_DOXYGEN
+    /** Reception time of the last SYNC message, see
+     * CO_CANrxMsg_readTimestamp() */
+    uint64_t timestamp_us;
+#endif
     /** Sync timeout monitoring: 0 = not started; 1 = started; 2 = sync timeout
      * error state */
     uint8_t timeoutError;
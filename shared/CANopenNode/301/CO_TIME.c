@@ -43,6 +43,9 @@ static void CO_TIME_receive(void *object, void *msg) {
 
     if (DLC == CO_TIME_MSG_LENGTH) {
         memcpy(TIME->timeStamp, data, sizeof(TIME->timeStamp));
+#ifdef CO_CANrxMsg_readTimestamp
+        TIME->timestamp_us = CO_CANrxMsg_readTimestamp(msg);
+#endif
         CO_FLAG_SET(TIME->CANrxNew);
 
 #if (CO_CONFIG_TIME) & CO_CONFIG_FLAG_CALLBACK_PRE
@@ -95,6 +95,11 @@ typedef struct {
     bool_t isProducer;
     /** Variable indicates, if new TIME message received from CAN bus */
     volatile void *CANrxNew;
+#if defined CO_CANrxMsg_readTimestamp || defined CO_DOXYGEN
+    /** Reception time of the last TIME message, see
+     * CO_CANrxMsg_readTimestamp() */
+    uint64_t timestamp_us;
+#endif
 #if ((CO_CONFIG_TIME) & CO_CONFIG_TIME_PRODUCER) || defined CO_DOXYGEN
     /** Interval for time producer in milli seconds */
     uint32_t producerInterval_ms;
@@ -29,7 +29,12 @@
 #include <string.h>
 
 #include "CANOpenNode/CO_config.h"
+/* Host builds define CO_DRIVER_VIRTUAL to run on the in-process virtual bus */
+#ifdef CO_DRIVER_VIRTUAL
+#include "bsp/CANOpenNode/CO_driver_virtual.h"
+#else
 #include "bsp/CANOpenNode/CO_driver_stm32.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -249,6 +254,19 @@ static inline uint8_t *CO_CANrxMsg_readData(void *rxMsg) {
     return NULL;
 }
 
+/**
+ * CANrx_callback() can read the reception time of a CAN message
+ *
+ * Optional, may be defined in the **CO_driver_target.h** file as a macro. If it
+ * is, SYNC, TIME and RPDO objects keep the time of the last received message.
+ *
+ * @param rxMsg Pointer to received message
+ * @return Start of the message in microseconds, on a target specific timebase
+ */
+static inline uint64_t CO_CANrxMsg_readTimestamp(void *rxMsg) {
+    return 0;
+}
+
 /**
  * Configuration object for CAN received message for specific \ref CO_obj
  * "CANopenNode Object".
@@ -67,6 +67,15 @@ void CO_fifo_init(CO_fifo_t *fifo, uint8_t *buf, size_t bufSize) {
 }
 
 
+/* Number of bytes that can be copied from ptr up to writePtr without
+ * wrapping around the end of the buffer. */
+static size_t CO_fifo_spanOccupied(const CO_fifo_t *fifo, size_t ptr) {
+    const size_t writePtr = fifo->writePtr;
+
+    return (writePtr >= ptr) ? writePtr - ptr : fifo->bufSize - ptr;
+}
+
+
 /* Circular FIFO buffer example for fifo->bufSize = 7 (usable size = 6): ******
  *                                                                            *
  *   0      *            *             *            *                         *
@@ -85,51 +94,49 @@ size_t CO_fifo_write(CO_fifo_t *fifo,
                      size_t count,
                      uint16_t *crc)
 {
-    size_t i;
-    uint8_t *bufDest;
+    size_t written = 0;
 
     if (fifo == NULL || fifo->buf == NULL || buf == NULL) {
         return 0;
     }
 
-    bufDest = &fifo->buf[fifo->writePtr];
-    for (i = count; i > 0; i--) {
-        size_t writePtrNext = fifo->writePtr + 1;
+    /* Free space is one span up to the end of the buffer or up to readPtr,
+     * so at most two copies are needed. One byte always stays unused. */
+    while (written < count) {
+        const size_t readPtr = fifo->readPtr;
+        const size_t writePtr = fifo->writePtr;
+        size_t span = (readPtr > writePtr)
+                    ? readPtr - writePtr - 1
+                    : fifo->bufSize - writePtr - (readPtr == 0 ? 1 : 0);
 
-        /* is circular buffer full */
-        if (writePtrNext == fifo->readPtr ||
-            (writePtrNext == fifo->bufSize && fifo->readPtr == 0)) {
+        if (span == 0) {
             break;
         }
+        if (span > count - written) {
+            span = count - written;
+        }
 
-        *bufDest = *buf;
+        memcpy(&fifo->buf[writePtr], &buf[written], span);
 
 #if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_CRC16_CCITT
         if (crc != NULL) {
-            crc16_ccitt_single(crc, *buf);
+            *crc = crc16_ccitt(&buf[written], span, *crc);
         }
 #endif
 
-        /* increment variables */
-        if (writePtrNext == fifo->bufSize) {
-            fifo->writePtr = 0;
-            bufDest = &fifo->buf[0];
-        }
-        else {
-            fifo->writePtr++;
-            bufDest++;
-        }
-        buf++;
+        /* data is in place before the reader can see it */
+        written += span;
+        fifo->writePtr = (writePtr + span == fifo->bufSize)
+                       ? 0 : writePtr + span;
     }
 
-    return count - i;
+    return written;
 }
 
 
 /******************************************************************************/
 size_t CO_fifo_read(CO_fifo_t *fifo, uint8_t *buf, size_t count, bool_t *eof) {
-    size_t i;
-    const uint8_t *bufSrc;
+    size_t copied = 0;
 
     if (eof != NULL) {
         *eof = false;
@@ -138,63 +145,66 @@ size_t CO_fifo_read(CO_fifo_t *fifo, uint8_t *buf, size_t count, bool_t *eof) {
         return 0;
     }
 
-    bufSrc = &fifo->buf[fifo->readPtr];
-    for (i = count; i > 0; ) {
-        const uint8_t c = *bufSrc;
+    while (copied < count) {
+        const size_t readPtr = fifo->readPtr;
+        size_t span = CO_fifo_spanOccupied(fifo, readPtr);
+        bool_t delimiter = false;
 
-        /* is circular buffer empty */
-        if (fifo->readPtr == fifo->writePtr) {
+        if (span == 0) {
             break;
         }
-
-        *(buf++) = c;
-
-        /* increment variables */
-        if (++fifo->readPtr == fifo->bufSize) {
-            fifo->readPtr = 0;
-            bufSrc = &fifo->buf[0];
-        }
-        else {
-            bufSrc++;
+        if (span > count - copied) {
+            span = count - copied;
         }
-        i--;
 
 #if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ASCII_COMMANDS
-        /* is delimiter? */
-        if (eof != NULL && c == DELIM_COMMAND) {
+        /* is delimiter? It is read, then reading stops. */
+        if (eof != NULL) {
+            const uint8_t *d = (const uint8_t *)memchr(&fifo->buf[readPtr],
+                                                       DELIM_COMMAND, span);
+            if (d != NULL) {
+                span = (size_t)(d - &fifo->buf[readPtr]) + 1;
+                delimiter = true;
+            }
+        }
+#endif
+
+        memcpy(&buf[copied], &fifo->buf[readPtr], span);
+        copied += span;
+        fifo->readPtr = (readPtr + span == fifo->bufSize) ? 0 : readPtr + span;
+
+        if (delimiter) {
             *eof = true;
             break;
         }
-#endif
     }
 
-    return count - i;
+    return copied;
 }
 
 
 #if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ALT_READ
 /******************************************************************************/
 size_t CO_fifo_altBegin(CO_fifo_t *fifo, size_t offset) {
-    size_t i;
+    size_t occupied;
 
     if (fifo == NULL) {
         return 0;
     }
 
-    fifo->altReadPtr = fifo->readPtr;
-    for (i = offset; i > 0; i--) {
-        /* is circular buffer empty */
-        if (fifo->altReadPtr == fifo->writePtr) {
-            break;
-        }
+    occupied = (fifo->writePtr >= fifo->readPtr)
+             ? fifo->writePtr - fifo->readPtr
+             : fifo->bufSize - fifo->readPtr + fifo->writePtr;
+    if (offset > occupied) {
+        offset = occupied;
+    }
 
-        /* increment variable */
-        if (++fifo->altReadPtr == fifo->bufSize) {
-            fifo->altReadPtr = 0;
-        }
+    fifo->altReadPtr = fifo->readPtr + offset;
+    if (fifo->altReadPtr >= fifo->bufSize) {
+        fifo->altReadPtr -= fifo->bufSize;
     }
 
-    return offset - i;
+    return offset;
 }
 
 void CO_fifo_altFinish(CO_fifo_t *fifo, uint16_t *crc) {
@@ -203,53 +213,48 @@ void CO_fifo_altFinish(CO_fifo_t *fifo, uint16_t *crc) {
         return;
     }
 
-    if (crc == NULL) {
-        fifo->readPtr = fifo->altReadPtr;
-    }
-    else {
-        const uint8_t *bufSrc = &fifo->buf[fifo->readPtr];
-        while (fifo->readPtr != fifo->altReadPtr) {
 #if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_CRC16_CCITT
-            crc16_ccitt_single(crc, *bufSrc);
-#endif
-            /* increment variable */
-            if (++fifo->readPtr == fifo->bufSize) {
-                fifo->readPtr = 0;
-                bufSrc = &fifo->buf[0];
-            }
-            else {
-                bufSrc++;
-            }
+    if (crc != NULL) {
+        /* bytes between readPtr and altReadPtr, in one or two spans */
+        if (fifo->altReadPtr >= fifo->readPtr) {
+            *crc = crc16_ccitt(&fifo->buf[fifo->readPtr],
+                               fifo->altReadPtr - fifo->readPtr, *crc);
+        }
+        else {
+            *crc = crc16_ccitt(&fifo->buf[fifo->readPtr],
+                               fifo->bufSize - fifo->readPtr, *crc);
+            *crc = crc16_ccitt(&fifo->buf[0], fifo->altReadPtr, *crc);
         }
     }
+#else
+    (void)crc;
+#endif
+
+    fifo->readPtr = fifo->altReadPtr;
 }
 
 size_t CO_fifo_altRead(CO_fifo_t *fifo, uint8_t *buf, size_t count) {
-    size_t i;
-    const uint8_t *bufSrc;
+    size_t copied = 0;
 
-    bufSrc = &fifo->buf[fifo->altReadPtr];
-    for (i = count; i > 0; i--) {
-        const uint8_t c = *bufSrc;
+    while (copied < count) {
+        const size_t altReadPtr = fifo->altReadPtr;
+        size_t span = CO_fifo_spanOccupied(fifo, altReadPtr);
 
         /* is there no more data */
-        if (fifo->altReadPtr == fifo->writePtr) {
+        if (span == 0) {
             break;
         }
-
-        *(buf++) = c;
-
-        /* increment variables */
-        if (++fifo->altReadPtr == fifo->bufSize) {
-            fifo->altReadPtr = 0;
-            bufSrc = &fifo->buf[0];
-        }
-        else {
-            bufSrc++;
+        if (span > count - copied) {
+            span = count - copied;
         }
+
+        memcpy(&buf[copied], &fifo->buf[altReadPtr], span);
+        copied += span;
+        fifo->altReadPtr = (altReadPtr + span == fifo->bufSize)
+                         ? 0 : altReadPtr + span;
     }
 
-    return count - i;
+    return copied;
 }
 #endif /* (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ALT_READ */
 
@@ -33,6 +33,11 @@
 #ifndef CO_CONFIG_CRC16
 #define CO_CONFIG_CRC16 (0)
 #endif
+/* Bytes crc16_ccitt_sw() processes per table step: 1, 4 or 8. Besides the
+ * basic 512 byte table it takes (N - 1) x 512 bytes of flash. */
+#ifndef CO_CONFIG_CRC16_SLICES
+#define CO_CONFIG_CRC16_SLICES 8
+#endif
 
 #if ((CO_CONFIG_CRC16) & CO_CONFIG_CRC16_ENABLE) || defined CO_DOXYGEN
 
@@ -81,6 +86,25 @@ uint16_t crc16_ccitt(const uint8_t block[],
                      uint16_t crc);
 
 
+
+/**
+ * Calculate CRC sum on block of data in software.
+ *
+ * Slicing-by-N implementation, see @ref CO_CONFIG_CRC16_SLICES. It is
+ * crc16_ccitt() unless @ref CO_CONFIG_CRC16_EXTERNAL is set, an external
+ * implementation may use it as fallback.
+ *
+ * @param block Pointer to block of data.
+ * @param blockLength Length of data in bytes;
+ * @param crc Initial value (zero for xmodem).
+ *
+ * @return Calculated CRC.
+ */
+uint16_t crc16_ccitt_sw(const uint8_t block[],
+                        size_t blockLength,
+                        uint16_t crc);
+
+
 /** @} */ /* CO_crc16_ccitt */
 
 #ifdef __cplusplus
@@ -0,0 +1,477 @@
+/*
+ * DeferredLog.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#include "DeferredLog.h"
+
+#include <string.h>
+
+#include "Logging/printf.h"
+
+namespace
+{
+
+typedef enum : uint8_t
+{
+	ARG_NONE, ARG_INT, ARG_LONG, ARG_LONG_LONG, ARG_DOUBLE, ARG_STRING, ARG_POINTER
+} ArgType;
+
+// One conversion specification of a format string
+typedef struct
+{
+	const char *begin; // Points to '%'
+	const char *end; // One past the conversion character
+	uint8_t stars; // Number of '*' width/precision arguments
+	bool precisionStar;
+	int precision; // -1 if not given as digits
+	ArgType type;
+} Spec;
+
+// Longest conversion specification unpack() can re-create, e.g. "%-#0*.*llX"
+const size_t MAX_SPEC_LENGTH = 16;
+
+// Mirrors the grammar accepted by _vsnprintf() in printf.c, fmt must point to '%'
+const char* parseSpec(const char *fmt, Spec *spec)
+{
+	spec->begin = fmt++;
+	spec->stars = 0;
+	spec->precisionStar = false;
+	spec->precision = -1;
+
+	// Flags
+	while (*fmt == '0' || *fmt == '-' || *fmt == '+' || *fmt == ' ' || *fmt == '#')
+	{
+		fmt++;
+	}
+	// Width
+	if (*fmt == '*')
+	{
+		spec->stars++;
+		fmt++;
+	}
+	else
+	{
+		while (*fmt >= '0' && *fmt <= '9')
+		{
+			fmt++;
+		}
+	}
+	// Precision
+	if (*fmt == '.')
+	{
+		fmt++;
+		if (*fmt == '*')
+		{
+			spec->stars++;
+			spec->precisionStar = true;
+			fmt++;
+		}
+		else
+		{
+			spec->precision = 0;
+			while (*fmt >= '0' && *fmt <= '9')
+			{
+				spec->precision = spec->precision * 10 + (*fmt++ - '0');
+			}
+		}
+	}
+	// Length
+	ArgType integer = ARG_INT;
+	switch (*fmt)
+	{
+	case 'l':
+		integer = ARG_LONG;
+		if (*++fmt == 'l')
+		{
+			integer = ARG_LONG_LONG;
+			fmt++;
+		}
+		break;
+	case 'h':
+		if (*++fmt == 'h')
+		{
+			fmt++;
+		}
+		break;
+	case 't':
+		integer = (sizeof(ptrdiff_t) == sizeof(long)) ? ARG_LONG : ARG_LONG_LONG;
+		fmt++;
+		break;
+	case 'j':
+		integer = (sizeof(intmax_t) == sizeof(long)) ? ARG_LONG : ARG_LONG_LONG;
+		fmt++;
+		break;
+	case 'z':
+		integer = (sizeof(size_t) == sizeof(long)) ? ARG_LONG : ARG_LONG_LONG;
+		fmt++;
+		break;
+	default:
+		break;
+	}
+	// Specifier
+	switch (*fmt)
+	{
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+	case 'b':
+		spec->type = integer;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+		spec->type = ARG_DOUBLE;
+		break;
+	case 'c':
+		spec->type = ARG_INT;
+		break;
+	case 's':
+		spec->type = ARG_STRING;
+		break;
+	case 'p':
+		spec->type = ARG_POINTER;
+		break;
+	default:
+		spec->type = ARG_NONE;
+		break;
+	}
+	if (*fmt)
+	{
+		fmt++;
+	}
+	spec->end = fmt;
+	return fmt;
+}
+
+template<typename T>
+bool put(uint8_t *buf, size_t size, size_t *idx, T value)
+{
+	if (*idx + sizeof(T) > size)
+	{
+		return false;
+	}
+	memcpy(buf + *idx, &value, sizeof(T));
+	*idx += sizeof(T);
+	return true;
+}
+
+template<typename T>
+bool get(const uint8_t *buf, size_t size, size_t *idx, T *value)
+{
+	if (*idx + sizeof(T) > size)
+	{
+		return false;
+	}
+	memcpy(value, buf + *idx, sizeof(T));
+	*idx += sizeof(T);
+	return true;
+}
+
+template<typename T>
+int emit(char *buf, size_t size, const char *spec, const int *stars,
+		uint8_t count, T value)
+{
+	switch (count)
+	{
+	case 0:
+		return snprintf(buf, size, spec, value);
+	case 1:
+		return snprintf(buf, size, spec, stars[0], value);
+	default:
+		return snprintf(buf, size, spec, stars[0], stars[1], value);
+	}
+}
+
+} // namespace
+
+size_t DeferredLog::pack(uint8_t *buf, size_t size, const char *fmt,
+		va_list args)
+{
+	size_t idx = 0;
+	while ((fmt = strchr(fmt, '%')) != nullptr)
+	{
+		Spec spec;
+		int stars[2] =
+		{ 0, 0 };
+		fmt = parseSpec(fmt, &spec);
+
+		for (uint8_t i = 0; i < spec.stars; i++)
+		{
+			stars[i] = va_arg(args, int);
+			if (!put(buf, size, &idx, stars[i]))
+			{
+				return idx;
+			}
+		}
+
+		bool ok = true;
+		switch (spec.type)
+		{
+		case ARG_INT:
+			ok = put(buf, size, &idx, va_arg(args, int));
+			break;
+		case ARG_LONG:
+			ok = put(buf, size, &idx, va_arg(args, long));
+			break;
+		case ARG_LONG_LONG:
+			ok = put(buf, size, &idx, va_arg(args, long long));
+			break;
+		case ARG_DOUBLE:
+			ok = put(buf, size, &idx, va_arg(args, double));
+			break;
+		case ARG_POINTER:
+			ok = put(buf, size, &idx, va_arg(args, void*));
+			break;
+		case ARG_STRING:
+		{
+			// The string may not outlive the caller, copy it
+			const char *s = va_arg(args, const char*);
+			const int precision =
+					spec.precisionStar ? stars[spec.stars - 1] : spec.precision;
+			size_t n = 0;
+			if (s)
+			{
+				n = strnlen(s, precision >= 0 ? (size_t) precision : size);
+			}
+			if (idx + n + 1 > size)
+			{
+				return idx;
+			}
+			memcpy(buf + idx, s, n);
+			buf[idx + n] = '\0';
+			idx += n + 1;
+			break;
+		}
+		case ARG_NONE:
+		default:
+			break;
+		}
+		if (!ok)
+		{
+			return idx;
+		}
+	}
+	return idx;
+}
+
+size_t DeferredLog::unpack(char *buf, size_t size, const char *fmt,
+		const uint8_t *args, size_t length)
+{
+	if (!size)
+	{
+		return 0;
+	}
+	size_t idx = 0;
+	size_t offs = 0;
+	bool truncated = false;
+	while (*fmt && idx < size - 1)
+	{
+		// Literal text up to the next conversion
+		const char *pct = strchr(fmt, '%');
+		size_t n = pct ? (size_t) (pct - fmt) : strlen(fmt);
+		if (n > size - 1 - idx)
+		{
+			n = size - 1 - idx;
+			truncated = true;
+		}
+		memcpy(buf + idx, fmt, n);
+		idx += n;
+		if (!pct || truncated)
+		{
+			break;
+		}
+
+		Spec spec;
+		fmt = parseSpec(pct, &spec);
+
+		char format[MAX_SPEC_LENGTH];
+		const size_t flen = spec.end - spec.begin;
+		if (flen >= sizeof(format))
+		{
+			truncated = true;
+			break;
+		}
+		memcpy(format, spec.begin, flen);
+		format[flen] = '\0';
+
+		int stars[2] =
+		{ 0, 0 };
+		bool ok = true;
+		for (uint8_t i = 0; i < spec.stars; i++)
+		{
+			ok = ok && get(args, length, &offs, &stars[i]);
+		}
+
+		int written = 0;
+		switch (spec.type)
+		{
+		case ARG_INT:
+		{
+			int value = 0;
+			ok = ok && get(args, length, &offs, &value);
+			written = emit(buf + idx, size - idx, format, stars, spec.stars, value);
+			break;
+		}
+		case ARG_LONG:
+		{
+			long value = 0;
+			ok = ok && get(args, length, &offs, &value);
+			written = emit(buf + idx, size - idx, format, stars, spec.stars, value);
+			break;
+		}
+		case ARG_LONG_LONG:
+		{
+			long long value = 0;
+			ok = ok && get(args, length, &offs, &value);
+			written = emit(buf + idx, size - idx, format, stars, spec.stars, value);
+			break;
+		}
+		case ARG_DOUBLE:
+		{
+			double value = 0;
+			ok = ok && get(args, length, &offs, &value);
+			written = emit(buf + idx, size - idx, format, stars, spec.stars, value);
+			break;
+		}
+		case ARG_POINTER:
+		{
+			void *value = nullptr;
+			ok = ok && get(args, length, &offs, &value);
+			written = emit(buf + idx, size - idx, format, stars, spec.stars, value);
+			break;
+		}
+		case ARG_STRING:
+		{
+			const char *value = (const char*) args + offs;
+			const size_t n = (offs < length) ? strnlen(value, length - offs) : 0;
+			ok = ok && (offs + n < length);
+			offs += n + 1;
+			written = emit(buf + idx, size - idx, format, stars, spec.stars,
+					ok ? value : "");
+			break;
+		}
+		case ARG_NONE:
+		default:
+			written = emit(buf + idx, size - idx, format, stars, spec.stars, 0);
+			break;
+		}
+		if (!ok)
+		{
+			truncated = true; // Arguments did not fit when the message was captured
+			break;
+		}
+		idx += (written > 0) ? (size_t) written : 0;
+		if (idx > size - 1)
+		{
+			idx = size - 1;
+			truncated = true;
+		}
+	}
+	if (truncated && size > 1)
+	{
+		if (idx == size - 1)
+		{
+			idx--;
+		}
+		buf[idx++] = '~';
+	}
+	buf[idx] = '\0';
+	return idx;
+}
+
+int DeferredLog::log_defer_callback(int level, const char *category,
+		const LogAttributes *attr, const char *fmt, va_list args,
+		void *reserved)
+{
+	if (level >= LOG_DEFERRED_SYNC_LEVEL)
+	{
+		return 0; // Format now, the system may not survive until the log task runs
+	}
+	DeferredLog *log = getInstance();
+
+	uint8_t packed[LOG_DEFERRED_MAX_ARGS_SIZE];
+	size_t length = pack(packed, sizeof(packed), fmt, args);
+
+	// Details may not outlive the caller either, copy them after the arguments
+	size_t details = 0;
+	if (attr->has_details && attr->details)
+	{
+		details = strlen(attr->details) + 1;
+		if (details > sizeof(packed) - length)
+		{
+			return 0;
+		}
+		memcpy(packed + length, attr->details, details);
+		length += details;
+	}
+
+	uint8_t *data = log->ring.reserve(sizeof(Record) + length);
+	if (data)
+	{
+		Record rec;
+		rec.fmt = fmt;
+		rec.category = category;
+		rec.level = level;
+		rec.attr = *attr;
+		rec.details = (uint16_t) details;
+		memcpy(data, &rec, sizeof(rec));
+		memcpy(data + sizeof(rec), packed, length);
+		log->ring.commit(data, sizeof(rec) + length);
+		osThreadFlagsSet(log->ProcessLogHandle, PENDING_FLAG);
+	}
+	return 1;
+}
+
+__NO_RETURN void DeferredLog::main(void *arg)
+{
+	DeferredLog *log = (DeferredLog*) arg;
+	char buf[LOG_MAX_STRING_LENGTH];
+
+	for (;;)
+	{
+		size_t length;
+		const uint8_t *data;
+		while ((data = log->ring.peek(&length)) != nullptr)
+		{
+			Record rec;
+			memcpy(&rec, data, sizeof(rec));
+			const size_t args = length - sizeof(rec) - rec.details;
+			if (rec.details)
+			{
+				rec.attr.details = (const char*) data + sizeof(rec) + args;
+			}
+			unpack(buf, sizeof(buf), rec.fmt, data + sizeof(rec), args);
+			log_message_str(rec.level, rec.category, &rec.attr, buf, nullptr);
+			log->ring.pop();
+		}
+		// Set by log_defer_callback(), also if it committed after the ring was found empty
+		osThreadFlagsWait(PENDING_FLAG, osFlagsWaitAny, osWaitForever);
+	}
+	osThreadExit();
+}
+
+void DeferredLog::start(osPriority_t priority)
+{
+	if (ProcessLogHandle != nullptr)
+	{
+		return;
+	}
+
+	ProcessLog_attributes.priority = priority;
+	ProcessLog_attributes.stack_size = 2048 * 4;
+
+	/* creation of ProcessLog */
+	ProcessLogHandle = osThreadNew(this->main, (void*) this,
+			&ProcessLog_attributes);
+
+	log_set_defer_callback(log_defer_callback, nullptr);
+}
@@ -0,0 +1,129 @@
+/*
+ * DeferredLog.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_LOGGING_DEFERREDLOG_H_
+#define SRC_SHARED_LOGGING_DEFERREDLOG_H_
+
+#include <cstdint>
+#include <stdarg.h>
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "logging.h"
+#include "LogRing.h"
+
+// Size of the ring holding captured messages (bytes, power of two)
+#ifndef LOG_DEFERRED_BUFFER_SIZE
+#define LOG_DEFERRED_BUFFER_SIZE 4096
+#endif
+
+// Maximum size of the packed arguments of one message, including copied strings
+#ifndef LOG_DEFERRED_MAX_ARGS_SIZE
+#define LOG_DEFERRED_MAX_ARGS_SIZE 128
+#endif
+
+// Messages at or above this level are still formatted on the caller's thread
+#ifndef LOG_DEFERRED_SYNC_LEVEL
+#define LOG_DEFERRED_SYNC_LEVEL LOG_LEVEL_PANIC
+#endif
+
+/*!
+ \brief Moves message formatting off the caller's thread.
+
+ Once started, log_message() only copies the format string pointer, level, category,
+ attributes (including the timestamp) and the raw argument values into a lock-free ring.
+ A low priority task formats the message later and forwards it to the message callback
+ installed with log_set_callbacks() (e.g. \ref UARTLogHandler).
+
+ Because formatting happens later, `%s` arguments and the `details` attribute are copied at
+ capture time; every other argument is stored by value. Format strings must therefore be
+ string literals or otherwise outlive the message. Messages whose details do not fit next to
+ the arguments are formatted on the caller's thread.
+ */
+class DeferredLog
+{
+public:
+	static DeferredLog* getInstance()
+	{
+		static DeferredLog instance;
+		return &instance;
+	}
+
+	/*!
+	 \brief Creates the log task and starts capturing messages.
+	 \param priority Priority of the task formatting the messages.
+	 */
+	void start(osPriority_t priority = osPriorityLow);
+
+	/*!
+	 \brief Returns number of messages lost because the ring was full.
+	 */
+	uint32_t dropped() const
+	{
+		return ring.overflows();
+	}
+
+	/*!
+	 \brief Packs the arguments referenced by a format string into a buffer.
+	 \param buf Destination buffer.
+	 \param size Buffer size.
+	 \param fmt Format string.
+	 \param args Arguments.
+	 \return Number of bytes written.
+
+	 Arguments which do not fit are left out; \ref unpack() marks the message as truncated.
+	 */
+	static size_t pack(uint8_t *buf, size_t size, const char *fmt, va_list args);
+
+	/*!
+	 \brief Formats a message from arguments packed by \ref pack().
+	 \param buf Destination buffer.
+	 \param size Buffer size.
+	 \param fmt Format string.
+	 \param args Packed arguments.
+	 \param length Size of the packed arguments.
+	 \return Number of characters written, not counting the terminating null.
+	 */
+	static size_t unpack(char *buf, size_t size, const char *fmt,
+			const uint8_t *args, size_t length);
+
+	DeferredLog(const DeferredLog&) = delete;
+	DeferredLog& operator=(const DeferredLog&) = delete;
+
+private:
+	// Fixed part of a captured message, packed arguments follow
+	typedef struct
+	{
+		const char *fmt;
+		const char *category;
+		int level;
+		LogAttributes attr;
+		uint16_t details; // Bytes of attr.details copied after the arguments, 0 if none
+	} Record;
+
+	// Thread flag set for the log task when a message was captured
+	static const uint32_t PENDING_FLAG = 0x01;
+
+	LogRing<LOG_DEFERRED_BUFFER_SIZE> ring;
+
+	/* Definitions for ProcessLog */
+	osThreadId_t ProcessLogHandle = nullptr;
+	osThreadAttr_t ProcessLog_attributes =
+	{ .name = "ProcessLog", };
+
+	DeferredLog()
+	{
+	}
+
+	static void main(void*);
+
+	static int log_defer_callback(int level, const char *category,
+			const LogAttributes *attr, const char *fmt, va_list args,
+			void *reserved);
+};
+
+#endif /* SRC_SHARED_LOGGING_DEFERREDLOG_H_ */
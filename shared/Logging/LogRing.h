@@ -0,0 +1,261 @@
+/*
+ * LogRing.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_LOGGING_LOGRING_H_
+#define SRC_SHARED_LOGGING_LOGRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*!
+ \brief Lock-free multi-producer/single-consumer ring of variable sized records.
+
+ Producers claim space with a compare-and-swap on the head position and never block,
+ so reserve()/commit() may be called from any thread or ISR. A record is never split
+ across the end of the buffer; if it does not fit in the remaining space a skip record
+ pads the buffer up to the wrap point. The consumer only sees records in reservation
+ order, and only once they have been committed.
+
+ \tparam Capacity Buffer size in bytes, must be a power of two.
+ */
+template<size_t Capacity>
+class LogRing
+{
+	static_assert(Capacity >= 64 && (Capacity & (Capacity - 1)) == 0,
+			"LogRing capacity must be a power of two");
+	static_assert(Capacity <= 0x4000, "LogRing capacity must fit in a record header");
+
+public:
+	LogRing() :
+			_head(0), _tail(0), _overflows(0), _highWater(0)
+	{
+		memset(_buffer, 0, sizeof(_buffer));
+	}
+
+	/*!
+	 \brief Reserves space for a record.
+	 \param size Payload size in bytes.
+	 \param headroom Bytes that must remain free after the reservation.
+	 \return Pointer to the payload, or `nullptr` if the ring is full.
+
+	 The record stays invisible to the consumer until commit() is called. A non-zero headroom
+	 keeps space back for more important records reserved without one.
+	 */
+	uint8_t* reserve(size_t size, size_t headroom = 0)
+	{
+		const uint32_t need = align(size + HEADER_SIZE);
+		if (need > Capacity)
+		{
+			_overflows.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		uint32_t head = _head.load(std::memory_order_relaxed);
+		uint32_t pad;
+		do
+		{
+			const uint32_t contiguous = Capacity - (head & MASK);
+			pad = (need > contiguous) ? contiguous : 0;
+			if (head + pad + need + headroom - _tail.load(std::memory_order_acquire)
+					> Capacity)
+			{
+				_overflows.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+		} while (!_head.compare_exchange_weak(head, head + pad + need,
+				std::memory_order_acq_rel, std::memory_order_relaxed));
+
+		const uint32_t used = head + pad + need - _tail.load(std::memory_order_relaxed);
+		uint32_t highWater = _highWater.load(std::memory_order_relaxed);
+		while (used > highWater
+				&& !_highWater.compare_exchange_weak(highWater, used,
+						std::memory_order_relaxed))
+		{
+		}
+
+		if (pad)
+		{
+			header(head)->store(pad | SKIP | READY, std::memory_order_release);
+			head += pad;
+		}
+		header(head)->store(need, std::memory_order_relaxed);
+		return &_buffer[(head & MASK) + HEADER_SIZE];
+	}
+
+	/*!
+	 \brief Publishes a reserved record to the consumer.
+	 \param data Pointer returned by reserve().
+	 \param length Number of payload bytes actually written (not more than reserved).
+
+	 If nothing was reserved after this record, the unused part of the reservation is returned
+	 to the ring, so producers may reserve for the worst case. Bytes past `length` must not have
+	 been written, apart from a terminating null.
+	 */
+	void commit(uint8_t *data, size_t length)
+	{
+		std::atomic<uint32_t> *h = reinterpret_cast<std::atomic<uint32_t>*>(data
+				- HEADER_SIZE);
+		uint32_t size = h->load(std::memory_order_relaxed) & SIZE_MASK;
+		const uint32_t used = align(length + HEADER_SIZE);
+		if (used < size)
+		{
+			// The record can't be consumed yet, so the head is less than one lap past its end
+			const uint32_t end = (uint32_t) (data - HEADER_SIZE - _buffer) + size;
+			uint32_t head = _head.load(std::memory_order_relaxed);
+			if ((head & MASK) == (end & MASK)
+					&& _head.compare_exchange_strong(head, head - (size - used),
+							std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				size = used;
+			}
+		}
+		h->store(size | ((uint32_t) length << LENGTH_SHIFT) | READY,
+				std::memory_order_release);
+	}
+
+	/*!
+	 \brief Returns the oldest committed record without removing it.
+	 \param length Receives the payload length.
+	 \return Pointer to the payload, or `nullptr` if nothing is ready.
+
+	 Consumer side only.
+	 */
+	const uint8_t* peek(size_t *length)
+	{
+		for (;;)
+		{
+			const uint32_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail == _head.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+			const uint32_t h = header(tail)->load(std::memory_order_acquire);
+			if (!(h & READY))
+			{
+				return nullptr; // Oldest record is still being written
+			}
+			if (h & SKIP)
+			{
+				release(tail, h & SIZE_MASK);
+				continue;
+			}
+			*length = (h >> LENGTH_SHIFT) & LENGTH_MASK;
+			return &_buffer[(tail & MASK) + HEADER_SIZE];
+		}
+	}
+
+	/*!
+	 \brief Removes the record last returned by peek().
+
+	 Consumer side only.
+	 */
+	void pop()
+	{
+		const uint32_t tail = _tail.load(std::memory_order_relaxed);
+		release(tail, header(tail)->load(std::memory_order_relaxed) & SIZE_MASK);
+	}
+
+	/*!
+	 \brief Drops the oldest committed record to make room for new ones.
+	 \param length Receives the payload length of the dropped record.
+	 \return `false` if the ring is empty or its oldest record is still being written.
+
+	 Unlike the rest of the producer side this moves the tail, so it must never run concurrently
+	 with peek(), pop() or another discard(), e.g. by masking interrupts around all of them.
+	 */
+	bool discard(size_t *length)
+	{
+		for (;;)
+		{
+			const uint32_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail == _head.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			const uint32_t h = header(tail)->load(std::memory_order_acquire);
+			if (!(h & READY))
+			{
+				return false;
+			}
+			release(tail, h & SIZE_MASK);
+			if (!(h & SKIP))
+			{
+				*length = (h >> LENGTH_SHIFT) & LENGTH_MASK;
+				return true;
+			}
+		}
+	}
+
+	/*!
+	 \brief Returns number of records rejected because the ring was full.
+	 */
+	uint32_t overflows() const
+	{
+		return _overflows.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 \brief Returns number of bytes currently reserved or waiting for the consumer.
+	 */
+	size_t used() const
+	{
+		return _head.load(std::memory_order_relaxed)
+				- _tail.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 \brief Returns the largest value \ref used() has reached, including headers and padding.
+	 */
+	size_t highWater() const
+	{
+		return _highWater.load(std::memory_order_relaxed);
+	}
+
+	static constexpr size_t capacity()
+	{
+		return Capacity;
+	}
+
+	LogRing(const LogRing&) = delete;
+	LogRing& operator=(const LogRing&) = delete;
+
+private:
+	static const uint32_t HEADER_SIZE = sizeof(uint32_t);
+	static const uint32_t MASK = Capacity - 1;
+	static const uint32_t SIZE_MASK = 0xFFFF;
+	static const uint32_t LENGTH_SHIFT = 16;
+	static const uint32_t LENGTH_MASK = 0x3FFF;
+	static const uint32_t SKIP = 0x40000000;
+	static const uint32_t READY = 0x80000000;
+
+	alignas(uint32_t) uint8_t _buffer[Capacity];
+	std::atomic<uint32_t> _head;
+	std::atomic<uint32_t> _tail;
+	std::atomic<uint32_t> _overflows;
+	std::atomic<uint32_t> _highWater;
+
+	static uint32_t align(size_t size)
+	{
+		return (size + HEADER_SIZE - 1) & ~(HEADER_SIZE - 1);
+	}
+
+	std::atomic<uint32_t>* header(uint32_t position)
+	{
+		return reinterpret_cast<std::atomic<uint32_t>*>(&_buffer[position & MASK]);
+	}
+
+	void release(uint32_t tail, uint32_t size)
+	{
+		// Stale bytes must not look like a committed header to the next lap
+		memset(&_buffer[tail & MASK], 0, size);
+		_tail.store(tail + size, std::memory_order_release);
+	}
+};
+
+#endif /* SRC_SHARED_LOGGING_LOGRING_H_ */
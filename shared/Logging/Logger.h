@@ -165,6 +165,10 @@ public:
 	void operator()(const char *fmt, ...) const
 	__attribute__((format(printf, 2, 3)))
 	{
+		if (!enabled(DEFAULT_LEVEL))
+		{
+			return;
+		}
 		va_list args;
 		va_start(args, fmt);
 		log(DEFAULT_LEVEL, fmt, args);
@@ -176,6 +180,10 @@ public:
 	void operator()(LogLevel level, const char *fmt, ...) const
 	__attribute__((format(printf, 3, 4)))
 	{
+		if (!enabled(level))
+		{
+			return;
+		}
 		va_list args;
 		va_start(args, fmt);
 		log(level, fmt, args);
@@ -190,6 +198,8 @@ private:
 	const char *const name_; // Category name
 
 	void log(LogLevel level, const char *fmt, va_list args) const;
+	// Checked before any formatting, see log_level_enabled()
+	bool enabled(LogLevel level) const;
 };
 
 inline Logger::Logger(const char *name) :
@@ -199,6 +209,10 @@ inline Logger::Logger(const char *name) :
 
 inline void Logger::trace(const char *fmt, ...) const
 {
+	if (!enabled(LOG_LEVEL_TRACE))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(LOG_LEVEL_TRACE, fmt, args);
@@ -207,6 +221,10 @@ inline void Logger::trace(const char *fmt, ...) const
 
 inline void Logger::debug(const char *fmt, ...) const
 {
+	if (!enabled(DEBUG_LEVEL))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(DEBUG_LEVEL, fmt, args);
@@ -215,6 +233,10 @@ inline void Logger::debug(const char *fmt, ...) const
 
 inline void Logger::info(const char *fmt, ...) const
 {
+	if (!enabled(LOG_LEVEL_INFO))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(LOG_LEVEL_INFO, fmt, args);
@@ -223,6 +245,10 @@ inline void Logger::info(const char *fmt, ...) const
 
 inline void Logger::warn(const char *fmt, ...) const
 {
+	if (!enabled(LOG_LEVEL_WARN))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(LOG_LEVEL_WARN, fmt, args);
@@ -231,6 +257,10 @@ inline void Logger::warn(const char *fmt, ...) const
 
 inline void Logger::error(const char *fmt, ...) const
 {
+	if (!enabled(LOG_LEVEL_ERROR))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(LOG_LEVEL_ERROR, fmt, args);
@@ -239,6 +269,10 @@ inline void Logger::error(const char *fmt, ...) const
 
 inline void Logger::log(const char *fmt, ...) const
 {
+	if (!enabled(DEFAULT_LEVEL))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(DEFAULT_LEVEL, fmt, args);
@@ -247,6 +281,10 @@ inline void Logger::log(const char *fmt, ...) const
 
 inline void Logger::log(LogLevel level, const char *fmt, ...) const
 {
+	if (!enabled(level))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log(level, fmt, args);
@@ -255,6 +293,10 @@ inline void Logger::log(LogLevel level, const char *fmt, ...) const
 
 inline void Logger::printf(const char *fmt, ...) const
 {
+	if (!enabled(DEFAULT_LEVEL))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log_printf_v(DEFAULT_LEVEL, name_, nullptr, fmt, args);
@@ -263,6 +305,10 @@ inline void Logger::printf(const char *fmt, ...) const
 
 inline void Logger::printf(LogLevel level, const char *fmt, ...) const
 {
+	if (!enabled(level))
+	{
+		return;
+	}
 	va_list args;
 	va_start(args, fmt);
 	log_printf_v(level, name_, nullptr, fmt, args);
@@ -286,7 +332,7 @@ inline void Logger::write(const char *data, size_t size) const
 
 inline void Logger::write(LogLevel level, const char *data, size_t size) const
 {
-	if (data)
+	if (data && enabled(level))
 	{
 		log_write(level, name_, data, size, nullptr);
 	}
@@ -299,7 +345,7 @@ inline void Logger::dump(const void *data, size_t size) const
 
 inline void Logger::dump(LogLevel level, const void *data, size_t size) const
 {
-	if (data)
+	if (data && enabled(level))
 	{
 		log_dump(level, name_, data, size, 0, nullptr);
 	}
@@ -330,6 +376,11 @@ inline bool Logger::isLevelEnabled(LogLevel level) const
 	return log_enabled(level, name_, nullptr);
 }
 
+inline bool Logger::enabled(LogLevel level) const
+{
+	return log_level_enabled(level, name_, nullptr);
+}
+
 inline const char* Logger::name() const
 {
 	return name_;
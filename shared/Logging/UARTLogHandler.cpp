@@ -0,0 +1,197 @@
+/*
+ * UARTLogHandler.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#include "UARTLogHandler.h"
+
+#include "Logging/printf.h"
+
+struct UARTLogHandler::Line
+{
+	UARTManager *uart;
+	char *data; // nullptr while the line is measured
+	size_t size; // Room for the text, "\r\n" is always appended
+	size_t idx;
+	bool truncated;
+
+	// Measures the line, written once reserve() made room for it
+	Line(UARTManager *uart) :
+			uart(uart), data(nullptr), size(LOG_MAX_LINE_LENGTH - 2), idx(0), truncated(false)
+	{
+	}
+
+	// Reserves the measured length. ERROR and PANIC lines may use the ring's reserve and push
+	// older output out.
+	bool reserve(LogLevel level)
+	{
+		size = idx;
+		idx = 0;
+		truncated = false;
+		data = uart->reserve(size + 2, level >= LOG_LEVEL_ERROR);
+		return data != nullptr;
+	}
+
+	static void out(char c, void *arg)
+	{
+		Line *line = (Line*) arg;
+		if (line->idx < line->size)
+		{
+			if (line->data)
+			{
+				line->data[line->idx] = c;
+			}
+			line->idx++;
+		}
+		else
+		{
+			line->truncated = true;
+		}
+	}
+
+	void write(const char *s, size_t n)
+	{
+		if (n > size - idx)
+		{
+			n = size - idx;
+			truncated = true;
+		}
+		if (data)
+		{
+			memcpy(data + idx, s, n);
+		}
+		idx += n;
+	}
+
+	void write(const char *s)
+	{
+		write(s, strlen(s));
+	}
+
+	void format(const char *fmt, ...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		vfctprintf(out, this, fmt, args);
+		va_end(args);
+	}
+
+	void commit()
+	{
+		if (truncated)
+		{
+			data[idx - 1] = '~';
+		}
+		data[idx++] = '\r';
+		data[idx++] = '\n';
+		uart->commit(data, idx);
+	}
+};
+
+void UARTLogHandler::writePrefix(Line &line, LogLevel level,
+		const char *category, const LogAttributes &attr)
+{
+	// Timestamp
+	if (attr.has_time)
+	{
+		line.format("%010u ", (unsigned) attr.time);
+	}
+	// Category
+	if (category)
+	{
+		line.write("[");
+		line.write(category);
+		line.write("] ");
+	}
+	// Source file
+	if (attr.has_file)
+	{
+		line.write(extractFileName(attr.file)); // Strip directory path
+		if (attr.has_line)
+		{
+			line.format(":%d", (int) attr.line); // Line number
+		}
+		line.write(attr.has_function ? ", " : ": ");
+	}
+	// Function name
+	if (attr.has_function)
+	{
+		size_t n = 0;
+		const char *s = extractFuncName(attr.function, &n); // Strip argument and return types
+		line.write(s, n);
+		line.write("(): ");
+	}
+	// Level
+	line.write(levelName(level));
+	line.write(": ");
+}
+
+void UARTLogHandler::writeSuffix(Line &line, const LogAttributes &attr)
+{
+	// Additional attributes
+	if (attr.has_code || attr.has_details)
+	{
+		line.write(" [");
+		// Code
+		if (attr.has_code)
+		{
+			line.format("code = %" PRIiPTR, (intptr_t) attr.code);
+		}
+		// Details
+		if (attr.has_details)
+		{
+			if (attr.has_code)
+			{
+				line.write(", ");
+			}
+			line.write("details = ");
+			line.write(attr.details);
+		}
+		line.write("]");
+	}
+}
+
+void UARTLogHandler::logMessage(const char *msg, LogLevel level,
+		const char *category, const LogAttributes &attr)
+{
+	Line line(uart);
+	writePrefix(line, level, category, attr);
+	if (msg)
+	{
+		line.write(msg);
+	}
+	writeSuffix(line, attr);
+	if (!line.reserve(level))
+	{
+		return; // Ring is full, counted by dropped()
+	}
+	writePrefix(line, level, category, attr);
+	if (msg)
+	{
+		line.write(msg);
+	}
+	writeSuffix(line, attr);
+	line.commit();
+}
+
+void UARTLogHandler::logMessage(const char *fmt, va_list args, LogLevel level,
+		const char *category, const LogAttributes &attr)
+{
+	Line line(uart);
+	va_list measure;
+	va_copy(measure, args);
+	writePrefix(line, level, category, attr);
+	vfctprintf(Line::out, &line, fmt, measure);
+	va_end(measure);
+	writeSuffix(line, attr);
+	if (!line.reserve(level))
+	{
+		return; // Ring is full, counted by dropped()
+	}
+	writePrefix(line, level, category, attr);
+	vfctprintf(Line::out, &line, fmt, args);
+	writeSuffix(line, attr);
+	line.commit();
+}
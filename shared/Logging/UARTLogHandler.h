@@ -8,16 +8,110 @@
 #ifndef SRC_SHARED_LOGGING_UARTLOGHANDLER_H_
 #define SRC_SHARED_LOGGING_UARTLOGHANDLER_H_
 
+#include <initializer_list>
+
 #include "Logger.h"
 #include "bsp/UART/UARTManager.h"
 
+// Longest formatted log line, longer lines are truncated. Each line reserves its own length in
+// the transmit ring.
+#ifndef LOG_MAX_LINE_LENGTH
+#define LOG_MAX_LINE_LENGTH 1024
+#endif
+
+// Maximum number of per-category levels, power of two
+#ifndef LOG_MAX_CATEGORY_FILTERS
+#define LOG_MAX_CATEGORY_FILTERS 16
+#endif
+
+/*!
+ \brief Logging level of one category.
+
+ The category name is stored by pointer and must outlive the handler (normally a string literal).
+ */
+typedef struct
+{
+	const char *category;
+	LogLevel level;
+} LogCategoryFilter;
+
 class UARTLogHandler
 {
 private:
+	static_assert((LOG_MAX_CATEGORY_FILTERS & (LOG_MAX_CATEGORY_FILTERS - 1)) == 0,
+			"LOG_MAX_CATEGORY_FILTERS must be a power of two");
+	static_assert(LOG_MAX_CATEGORY_FILTERS <= 64, "Filter indices are stored as int8_t");
+
+	// Hash slots per index, kept at most half full so probe sequences stay short
+	static const size_t FILTER_SLOTS = 2 * LOG_MAX_CATEGORY_FILTERS;
+
+	typedef struct
+	{
+		const char *name;
+		uint32_t hash;
+		LogLevel level;
+	} CategoryFilter;
+
 	UARTManager *uart;
 	LogLevel _level;
 
-	const char* extractFileName(const char *s)
+	CategoryFilter _filters[LOG_MAX_CATEGORY_FILTERS];
+	size_t _filterCount = 0;
+	int8_t _byPointer[FILTER_SLOTS]; // Filter index by category address, -1 if empty
+	int8_t _byName[FILTER_SLOTS]; // Filter index by category name hash, -1 if empty
+
+	static size_t pointerSlot(const char *category)
+	{
+		const uintptr_t p = (uintptr_t) category;
+		return ((p >> 2) ^ (p >> 7)) & (FILTER_SLOTS - 1);
+	}
+
+	static uint32_t nameHash(const char *category)
+	{
+		uint32_t hash = 2166136261U; // FNV-1a
+		while (*category)
+		{
+			hash = (hash ^ (uint8_t) *category++) * 16777619U;
+		}
+		return hash;
+	}
+
+	int findByName(const char *category, uint32_t hash) const
+	{
+		for (size_t i = hash & (FILTER_SLOTS - 1), n = 0; n < FILTER_SLOTS;
+				i = (i + 1) & (FILTER_SLOTS - 1), n++)
+		{
+			const int8_t idx = _byName[i];
+			if (idx < 0)
+			{
+				break;
+			}
+			if (_filters[idx].hash == hash
+					&& strcmp(_filters[idx].name, category) == 0)
+			{
+				return idx;
+			}
+		}
+		return -1;
+	}
+
+	static void insert(int8_t *index, size_t slot, int8_t idx)
+	{
+		while (index[slot] >= 0)
+		{
+			slot = (slot + 1) & (FILTER_SLOTS - 1);
+		}
+		index[slot] = idx;
+	}
+
+	// Log line being formatted in place in the transmit ring
+	struct Line;
+
+	void writePrefix(Line &line, LogLevel level, const char *category,
+			const LogAttributes &attr);
+	void writeSuffix(Line &line, const LogAttributes &attr);
+
+	static const char* extractFileName(const char *s)
 	{
 		const char *s1 = strrchr(s, '/');
 		if (s1)
@@ -27,7 +121,7 @@ private:
 		return s;
 	}
 
-	const char* extractFuncName(const char *s, size_t *size)
+	static const char* extractFuncName(const char *s, size_t *size)
 	{
 		const char *s1 = s;
 		for (; *s; ++s)
@@ -47,6 +141,8 @@ private:
 
 	explicit UARTLogHandler()
 	{
+		memset(_byPointer, -1, sizeof(_byPointer));
+		memset(_byName, -1, sizeof(_byName));
 	}
 	;
 
@@ -64,6 +160,13 @@ private:
 
 	}
 
+	static void log_format_callback(const char *fmt, va_list args, int level,
+			const char *category, const LogAttributes *attr, void *reserved)
+	{
+		UARTLogHandler *handler = getInstance();
+		handler->message(fmt, args, (LogLevel) level, category, *attr);
+	}
+
 	static void log_write_callback(const char *data, size_t size, int level,
 			const char *category, void *reserved)
 	{
@@ -77,7 +180,7 @@ private:
 			void *reserved)
 	{
 		UARTLogHandler *handler = getInstance();
-		return level >= (uint8_t) handler->level();
+		return level >= (int) handler->categoryLevel(category);
 	}
 
 public:
@@ -102,15 +205,33 @@ public:
 		instance->_level = level;
 		log_set_callbacks(log_message_callback, log_write_callback,
 				log_enabled_callback, nullptr);
+		log_set_format_callback(log_format_callback, nullptr);
 		return instance; //UARTLogHandler.instance;
 	}
 
+	/*!
+	 \brief Configures the handler with per-category levels.
+	 \param uart Output UART.
+	 \param level Level of categories without a filter.
+	 \param filters Category filters, e.g. `{ { "can", LOG_LEVEL_TRACE }, { "sd", LOG_LEVEL_WARN } }`.
+	 */
+	static UARTLogHandler* configure(UARTManager *uart, LogLevel level,
+			std::initializer_list<LogCategoryFilter> filters)
+	{
+		UARTLogHandler *instance = configure(uart, level);
+		for (const LogCategoryFilter &filter : filters)
+		{
+			instance->setCategoryLevel(filter.category, filter.level);
+		}
+		return instance;
+	}
+
 	void write(const char *data, size_t size, LogLevel level,
 			const char *category)
 	{
-		if (level >= _level)
+		if (level >= categoryLevel(category))
 		{
-			write(data, size);
+			uart->write(data, size, level >= LOG_LEVEL_ERROR);
 		}
 	}
 
@@ -134,18 +255,109 @@ public:
 	void setLevel(LogLevel level)
 	{
 		_level = level;
+		log_levels_changed(nullptr);
+	}
+
+	/*!
+	 \brief Returns logging level of a category.
+	 \param category Category name (can be null).
+
+	 Looks the category up by address first and falls back to comparing names, so a copy of a
+	 category string in another translation unit still matches. Does not allocate.
+	 */
+	LogLevel categoryLevel(const char *category) const
+	{
+		if (category == nullptr || _filterCount == 0)
+		{
+			return _level;
+		}
+		for (size_t i = pointerSlot(category), n = 0; n < FILTER_SLOTS;
+				i = (i + 1) & (FILTER_SLOTS - 1), n++)
+		{
+			const int8_t idx = _byPointer[i];
+			if (idx < 0)
+			{
+				break;
+			}
+			if (_filters[idx].name == category)
+			{
+				return _filters[idx].level;
+			}
+		}
+		const int idx = findByName(category, nameHash(category));
+		return (idx >= 0) ? _filters[idx].level : _level;
+	}
+
+	/*!
+	 \brief Sets logging level of a category.
+	 \param category Category name, stored by pointer.
+	 \param level Logging level.
+	 \return `false` if \ref LOG_MAX_CATEGORY_FILTERS categories already have a level.
+	 */
+	bool setCategoryLevel(const char *category, LogLevel level)
+	{
+		if (category == nullptr)
+		{
+			return false;
+		}
+		const uint32_t hash = nameHash(category);
+		bool ok = true;
+
+		// Lookups run lock-free from any context, so keep them out while the indices change
+		const uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		const int idx = findByName(category, hash);
+		if (idx >= 0)
+		{
+			_filters[idx].level = level;
+		}
+		else if (_filterCount < LOG_MAX_CATEGORY_FILTERS)
+		{
+			const int8_t added = (int8_t) _filterCount;
+			_filters[added].name = category;
+			_filters[added].hash = hash;
+			_filters[added].level = level;
+			insert(_byPointer, pointerSlot(category), added);
+			insert(_byName, hash & (FILTER_SLOTS - 1), added);
+			_filterCount++;
+		}
+		else
+		{
+			ok = false;
+		}
+		__set_PRIMASK(primask);
+
+		log_levels_changed(nullptr);
+		return ok;
+	}
+
+	/*!
+	 \brief Returns number of messages dropped because the transmit ring was full.
+	 */
+	uint32_t dropped() const
+	{
+		return uart->dropped();
 	}
 
 	// These methods are called by the LogManager
 	void message(const char *msg, LogLevel level, const char *category,
 			const LogAttributes &attr)
 	{
-		if (level >= _level)
+		if (level >= categoryLevel(category))
 		{
 			logMessage(msg, level, category, attr);
 		}
 	}
 
+	void message(const char *fmt, va_list args, LogLevel level,
+			const char *category, const LogAttributes &attr)
+	{
+		if (level >= categoryLevel(category))
+		{
+			logMessage(fmt, args, level, category, attr);
+		}
+	}
+
 	UARTLogHandler(const UARTLogHandler&) = delete;
 	UARTLogHandler& operator=(const UARTLogHandler&) = delete;
 
@@ -159,112 +371,37 @@ protected:
 
 	 Default implementation generates messages in the following format:
 	 `<timestamp> [category] [file]:[line], [function]: <level>: <message> [attributes]`.
+	 The line is measured, then written in place into exactly its length of the transmit ring;
+	 lines longer than \ref LOG_MAX_LINE_LENGTH are truncated and end with `~`.
 	 */
 	void logMessage(const char *msg, LogLevel level, const char *category,
-			const LogAttributes &attr)
-	{
-		const char *s = nullptr;
+			const LogAttributes &attr);
 
-		char buf[1024];
-		size_t idx = 0;
-		// Timestamp
-		if (attr.has_time)
-		{
-			idx += sprintf(buf + idx, "%010u ", (unsigned) attr.time);
-		}
-		// Category
-		if (category)
-		{
-			idx += sprintf(buf + idx, "[%s] ", category);
-		}
-		// Source file
-		if (attr.has_file)
-		{
-			s = extractFileName(attr.file); // Strip directory path
-			idx += sprintf(buf + idx, "%s", s); // File name
-			if (attr.has_line)
-			{
-				idx += sprintf(buf + idx, ":%d", (int) attr.line); // Line number
-			}
-			if (attr.has_function)
-			{
-				idx += sprintf(buf + idx, ", ");
-			}
-			else
-			{
-				idx += sprintf(buf + idx, ": ");
-			}
-		}
-		// Function name
-		if (attr.has_function)
-		{
-			size_t n = 0;
-			s = extractFuncName(attr.function, &n); // Strip argument and return types
-			idx += sprintf(buf + idx, "%.*s(): ", (int) n, s);
-		}
-		// Level
-		s = levelName(level);
-		idx += sprintf(buf + idx, "%s: ", s);
-		// Message
-		if (msg)
-		{
-			idx += sprintf(buf + idx, "%s", msg);
-		}
-		// Additional attributes
-		if (attr.has_code || attr.has_details)
-		{
-			idx += sprintf(buf + idx, " [");
-			// Code
-			if (attr.has_code)
-			{
-				idx += sprintf(buf + idx, "code = %" PRIiPTR,
-						(intptr_t) attr.code);
-			}
-			// Details
-			if (attr.has_details)
-			{
-				if (attr.has_code)
-				{
-					idx += sprintf(buf + idx, ", ");
-				}
-				idx += sprintf(buf + idx, "details = %s", attr.details);
-			}
-			idx += sprintf(buf + idx, "]");
-		}
-		idx += sprintf(buf + idx, "\r\n");
-		write(buf, idx);
+	/*!
+	 \brief Formats log message straight into the transmit ring.
+	 \param fmt Format string.
+	 \param args Arguments.
+	 \param level Logging level.
+	 \param category Category name (can be null).
+	 \param attr Message attributes.
 
-	}
+	 Same output as \ref logMessage(const char*, LogLevel, const char*, const LogAttributes&),
+	 but the message is only formatted once, without an intermediate buffer or heap allocation.
+	 */
+	void logMessage(const char *fmt, va_list args, LogLevel level,
+			const char *category, const LogAttributes &attr);
 
 	/*!
 	 \brief Writes character buffer to output stream.
 	 \param data Buffer.
 	 \param size Buffer size.
 
-	 This method is equivalent to `stream()->write((const uint8_t*)data, size)`.
+	 Lock-free and safe to call from ISRs. Data that does not fit in the transmit ring is
+	 dropped and counted, see \ref dropped().
 	 */
 	inline void write(const char *data, size_t size)
 	{
-		static osMutexId_t logMutex = nullptr;
-
-		if(logMutex == nullptr)
-		{
-			logMutex = osMutexNew(nullptr);
-		}
-
-		auto res = osMutexAcquire(logMutex, 10);
-
-		if(res != osOK)
-		{
-			return;
-		}
-
-		char buf[size + 1];
-		memcpy(buf, data, size);
-		buf[size] = '\0';
-		uart->print(buf);
-
-		osMutexRelease(logMutex);
+		uart->write(data, size);
 	}
 	/*!
 	 \brief Writes string to output stream.
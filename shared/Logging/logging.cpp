@@ -20,6 +20,7 @@
 #include "main.h"
 
 #include <algorithm>
+#include <atomic>
 //#include <cstdio>
 
 #include "Logging/printf.h"
@@ -43,6 +44,34 @@ namespace
 volatile log_message_callback_type log_msg_callback = 0;
 volatile log_write_callback_type log_write_callback = 0;
 volatile log_enabled_callback_type log_enabled_callback = 0;
+volatile log_defer_callback_type log_defer_callback = 0;
+volatile log_format_callback_type log_format_callback = 0;
+
+static_assert((LOG_LEVEL_CACHE_SIZE & (LOG_LEVEL_CACHE_SIZE - 1)) == 0,
+		"LOG_LEVEL_CACHE_SIZE must be a power of two");
+
+// Cached lowest enabled level of a category. `level` holds the cache generation in the upper
+// 24 bits and the level in the lower 8 bits, 0 marks an invalid entry
+struct LevelCacheEntry
+{
+	std::atomic<const char*> category;
+	std::atomic<uint32_t> level;
+};
+
+LevelCacheEntry level_cache[LOG_LEVEL_CACHE_SIZE];
+std::atomic<uint32_t> level_generation(1);
+
+// Levels probed to find the threshold of a category, the enabled callback is expected to be
+// monotonic in level
+const int probe_levels[] =
+{ LOG_LEVEL_TRACE, DEBUG_LEVEL, LOG_LEVEL_INFO, LOG_LEVEL_WARN, LOG_LEVEL_ERROR,
+		LOG_LEVEL_PANIC };
+
+inline LevelCacheEntry& level_cache_entry(const char *category)
+{
+	const uintptr_t p = (uintptr_t) category;
+	return level_cache[((p >> 2) ^ (p >> 7)) & (LOG_LEVEL_CACHE_SIZE - 1)];
+}
 
 } // namespace
 
@@ -53,13 +82,25 @@ void log_set_callbacks(log_message_callback_type log_msg,
 	log_msg_callback = log_msg;
 	log_write_callback = log_write;
 	log_enabled_callback = log_enabled;
+	log_levels_changed(nullptr);
+}
+
+void log_set_format_callback(log_format_callback_type log_format, void *reserved)
+{
+	log_format_callback = log_format;
+}
+
+void log_set_defer_callback(log_defer_callback_type log_defer, void *reserved)
+{
+	log_defer_callback = log_defer;
 }
 
 void log_message_v(int level, const char *category, LogAttributes *attr,
 		void *reserved, const char *fmt, va_list args)
 {
 	const log_message_callback_type msg_callback = log_msg_callback;
-	if (!msg_callback)
+	const log_format_callback_type format_callback = log_format_callback;
+	if ((!msg_callback && !format_callback) || !log_level_enabled(level, category, 0))
 	{
 		return;
 	}
@@ -68,18 +109,26 @@ void log_message_v(int level, const char *category, LogAttributes *attr,
 	{
 		LOG_ATTR_SET(*attr, time, HAL_GetTick());
 	}
-	char buf[LOG_MAX_STRING_LENGTH];
-	if (msg_callback)
+	// Hand the raw arguments off if a deferred logger is installed
+	const log_defer_callback_type defer_callback = log_defer_callback;
+	if (defer_callback && defer_callback(level, category, attr, fmt, args, 0))
 	{
-		const int n = vsnprintf(buf, sizeof(buf), fmt, args);
-
+		return;
+	}
+	// Let the handler format straight into its output
+	if (format_callback)
+	{
+		format_callback(fmt, args, level, category, attr, 0);
+		return;
+	}
+	char buf[LOG_MAX_STRING_LENGTH];
+	const int n = vsnprintf(buf, sizeof(buf), fmt, args);
 
-		if (n > (int) sizeof(buf) - 1)
-		{
-			buf[sizeof(buf) - 2] = '~';
-		}
-		msg_callback(buf, level, category, attr, 0);
+	if (n > (int) sizeof(buf) - 1)
+	{
+		buf[sizeof(buf) - 2] = '~';
 	}
+	msg_callback(buf, level, category, attr, 0);
 }
 
 void log_message(int level, const char *category, LogAttributes *attr,
@@ -91,6 +140,16 @@ void log_message(int level, const char *category, LogAttributes *attr,
 	va_end(args);
 }
 
+void log_message_str(int level, const char *category, const LogAttributes *attr, const char *msg,
+		void *reserved)
+{
+	const log_message_callback_type msg_callback = log_msg_callback;
+	if (msg_callback)
+	{
+		msg_callback(msg, level, category, attr, 0);
+	}
+}
+
 void log_write(int level, const char *category, const char *data, size_t size,
 		void *reserved)
 {
@@ -99,7 +158,7 @@ void log_write(int level, const char *category, const char *data, size_t size,
 		return;
 	}
 	const log_write_callback_type write_callback = log_write_callback;
-	if (write_callback)
+	if (write_callback && log_level_enabled(level, category, 0))
 	{
 		write_callback(data, size, level, category, 0);
 	}
@@ -109,7 +168,7 @@ void log_printf_v(int level, const char *category, void *reserved,
 		const char *fmt, va_list args)
 {
 	const log_write_callback_type write_callback = log_write_callback;
-	if (!write_callback)
+	if (!write_callback || !log_level_enabled(level, category, 0))
 	{
 		return;
 	}
@@ -140,7 +199,7 @@ void log_dump(int level, const char *category, const void *data, size_t size,
 		int flags, void *reserved)
 {
 	const log_write_callback_type write_callback = log_write_callback;
-	if (!size || (!write_callback))
+	if (!size || (!write_callback) || !log_level_enabled(level, category, 0))
 	{
 		return;
 	}
@@ -181,11 +240,61 @@ int log_enabled(int level, const char *category, void *reserved)
 	const log_enabled_callback_type enabled_callback = log_enabled_callback;
 	if (enabled_callback)
 	{
-		return enabled_callback(level, category, 0);
+		return log_level_enabled(level, category, 0);
 	}
 	return 0;
 }
 
+int log_level_enabled(int level, const char *category, void *reserved)
+{
+	const log_enabled_callback_type enabled_callback = log_enabled_callback;
+	if (!enabled_callback)
+	{
+		return 1;
+	}
+	LevelCacheEntry &entry = level_cache_entry(category);
+	const uint32_t generation = level_generation.load(std::memory_order_relaxed) << 8;
+
+	// Entry is valid if it was not rewritten while its category was being read
+	const uint32_t cached = entry.level.load(std::memory_order_acquire);
+	if ((cached & ~0xFFU) == generation
+			&& entry.category.load(std::memory_order_acquire) == category
+			&& entry.level.load(std::memory_order_acquire) == cached)
+	{
+		return level >= (int) (cached & 0xFFU);
+	}
+
+	int threshold = LOG_LEVEL_NONE;
+	for (const int probe : probe_levels)
+	{
+		if (enabled_callback(probe, category, 0))
+		{
+			threshold = probe;
+			break;
+		}
+	}
+
+	// Writers are serialized so an entry never pairs one category with another one's level
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	entry.level.store(0, std::memory_order_relaxed);
+	entry.category.store(category, std::memory_order_release);
+	entry.level.store(generation | (uint32_t) threshold, std::memory_order_release);
+	__set_PRIMASK(primask);
+
+	return level >= threshold;
+}
+
+void log_levels_changed(void *reserved)
+{
+	uint32_t generation = (level_generation.load(std::memory_order_relaxed) + 1) & 0xFFFFFFU;
+	if (generation == 0)
+	{
+		generation = 1; // 0 is reserved for invalid entries
+	}
+	level_generation.store(generation, std::memory_order_release);
+}
+
 const char* log_level_name(int level, void *reserved)
 {
 	static const char *const names[] =
@@ -89,12 +89,21 @@ typedef struct LogAttributes {
 typedef void (*log_message_callback_type)(const char *msg, int level, const char *category, const LogAttributes *attr,
         void *reserved);
 
+// Callback for single-pass message logging, the handler formats the message itself (used by log_message())
+typedef void (*log_format_callback_type)(const char *fmt, va_list args, int level, const char *category,
+        const LogAttributes *attr, void *reserved);
+
 // Callback for direct logging (used by log_write(), log_printf(), log_dump())
 typedef void (*log_write_callback_type)(const char *data, size_t size, int level, const char *category, void *reserved);
 
 // Callback invoked to check whether logging is enabled for particular level and category (used by log_enabled())
 typedef int (*log_enabled_callback_type)(int level, const char *category, void *reserved);
 
+// Callback invoked before a message is formatted (used by log_message()). Returns 1 if the message was consumed
+// for deferred formatting, in which case the arguments must not be used by the caller anymore
+typedef int (*log_defer_callback_type)(int level, const char *category, const LogAttributes *attr, const char *fmt,
+        va_list args, void *reserved);
+
 // Generates log message
 void log_message(int level, const char *category, LogAttributes *attr, void *reserved, const char *fmt, ...);
 
@@ -102,6 +111,9 @@ void log_message(int level, const char *category, LogAttributes *attr, void *res
 void log_message_v(int level, const char *category, LogAttributes *attr, void *reserved, const char *fmt,
         va_list args);
 
+// Forwards an already formatted message to the message callback
+void log_message_str(int level, const char *category, const LogAttributes *attr, const char *msg, void *reserved);
+
 // Forwards buffer to backend logger
 void log_write(int level, const char *category, const char *data, size_t size, void *reserved);
 
@@ -117,6 +129,13 @@ void log_dump(int level, const char *category, const void *data, size_t size, in
 // Returns 1 if logging is enabled for specified level and category
 int log_enabled(int level, const char *category, void *reserved);
 
+// Returns 1 if a message with specified level and category would reach the backend logger (also 1 if no enabled
+// callback is set). Checked before any formatting; the answer is cached per category, see log_levels_changed()
+int log_level_enabled(int level, const char *category, void *reserved);
+
+// Drops the cached per-category levels, must be called whenever the enabled callback changes its answers
+void log_levels_changed(void *reserved);
+
 // Returns log level name
 const char* log_level_name(int level, void *reserved);
 
@@ -124,6 +143,12 @@ const char* log_level_name(int level, void *reserved);
 void log_set_callbacks(log_message_callback_type log_msg, log_write_callback_type log_write,
         log_enabled_callback_type log_enabled, void *reserved);
 
+// Sets callback formatting messages in a single pass, takes precedence over the message callback (NULL to disable)
+void log_set_format_callback(log_format_callback_type log_format, void *reserved);
+
+// Sets callback capturing messages for deferred formatting (NULL formats messages on the caller's thread)
+void log_set_defer_callback(log_defer_callback_type log_defer, void *reserved);
+
 extern void HAL_Delay_Microseconds(uint32_t delay);
 
 #ifdef __cplusplus
@@ -138,6 +163,10 @@ extern void HAL_Delay_Microseconds(uint32_t delay);
 #define LOG_MAX_STRING_LENGTH 1024
 #endif
 
+#ifndef LOG_LEVEL_CACHE_SIZE
+#define LOG_LEVEL_CACHE_SIZE 16 // Entries in the per-category level cache, power of two
+#endif
+
 #ifndef LOG_INCLUDE_SOURCE_INFO
 #define LOG_INCLUDE_SOURCE_INFO 0
 #endif
@@ -238,51 +267,69 @@ static const char* const _log_category = NULL;
 #define LOG_C(_level, _category, _fmt, ...) \
         do { \
             if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
-                _LOG_ATTR_INIT(_attr); \
-                log_message(LOG_LEVEL_##_level, _category, &_attr, NULL, _fmt, ##__VA_ARGS__); \
+                const char* const _cat = _category; \
+                if (log_level_enabled(LOG_LEVEL_##_level, _cat, NULL)) { \
+                    _LOG_ATTR_INIT(_attr); \
+                    log_message(LOG_LEVEL_##_level, _cat, &_attr, NULL, _fmt, ##__VA_ARGS__); \
+                } \
             } \
         } while (0)
 
 #define LOG_ATTR_C(_level, _category, _attrs, _fmt, ...) \
         do { \
             if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
-                _LOG_ATTR_INIT(_attr); \
-                PP_FOR_EACH(_LOG_ATTR_SET, _attr, PP_ARGS(_attrs)); \
-                log_message(LOG_LEVEL_##_level, _category, &_attr, NULL, _fmt, ##__VA_ARGS__); \
+                const char* const _cat = _category; \
+                if (log_level_enabled(LOG_LEVEL_##_level, _cat, NULL)) { \
+                    _LOG_ATTR_INIT(_attr); \
+                    PP_FOR_EACH(_LOG_ATTR_SET, _attr, PP_ARGS(_attrs)); \
+                    log_message(LOG_LEVEL_##_level, _cat, &_attr, NULL, _fmt, ##__VA_ARGS__); \
+                } \
             } \
         } while (0)
 
 #define LOG_WRITE_C(_level, _category, _data, _size) \
         do { \
             if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
-                log_write(LOG_LEVEL_##_level, _category, _data, _size, NULL); \
+                const char* const _cat = _category; \
+                if (log_level_enabled(LOG_LEVEL_##_level, _cat, NULL)) { \
+                    log_write(LOG_LEVEL_##_level, _cat, _data, _size, NULL); \
+                } \
             } \
         } while (0)
 
 #define LOG_PRINT_C(_level, _category, _str) \
         do { \
             if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
-                const char* const _s = _str; \
-                log_write(LOG_LEVEL_##_level, _category, _s, strlen(_s), NULL); \
+                const char* const _cat = _category; \
+                if (log_level_enabled(LOG_LEVEL_##_level, _cat, NULL)) { \
+                    const char* const _s = _str; \
+                    log_write(LOG_LEVEL_##_level, _cat, _s, strlen(_s), NULL); \
+                } \
             } \
         } while (0)
 
 #define LOG_PRINTF_C(_level, _category, _fmt, ...) \
         do { \
             if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
-                log_printf(LOG_LEVEL_##_level, _category, NULL, _fmt, ##__VA_ARGS__); \
+                const char* const _cat = _category; \
+                if (log_level_enabled(LOG_LEVEL_##_level, _cat, NULL)) { \
+                    log_printf(LOG_LEVEL_##_level, _cat, NULL, _fmt, ##__VA_ARGS__); \
+                } \
             } \
         } while (0)
 
 #define LOG_DUMP_C(_level, _category, _data, _size) \
         do { \
             if (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL) { \
-                log_dump(LOG_LEVEL_##_level, _category, _data, _size, 0, NULL); \
+                const char* const _cat = _category; \
+                if (log_level_enabled(LOG_LEVEL_##_level, _cat, NULL)) { \
+                    log_dump(LOG_LEVEL_##_level, _cat, _data, _size, 0, NULL); \
+                } \
             } \
         } while (0)
 
 #define LOG_ENABLED_C(_level, _category) \
-        (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL && log_enabled(LOG_LEVEL_##_level, _category, NULL))
+        (LOG_LEVEL_##_level >= LOG_COMPILE_TIME_LEVEL && log_level_enabled(LOG_LEVEL_##_level, _category, NULL))
 
 #else // LOG_DISABLE
 
@@ -0,0 +1,253 @@
+/*
+ * CO_CANcapture.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#include "301/CO_driver.h"
+
+#if CO_CAN_CAPTURE
+
+#include "bsp/CANOpenNode/CO_CANcapture.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+
+#include "cmsis_os.h"
+#include "ff.h"
+#include "Logging/LogRing.h"
+
+namespace
+{
+
+// Ring record written by the interrupts, cut to DLC data bytes
+typedef struct
+{
+	uint32_t time_us; // Low bits of the timestamp, the writer extends them
+	uint16_t ident;
+	uint8_t flags;
+	uint8_t DLC;
+	uint8_t data[8];
+} Slot;
+
+const size_t SLOT_HEADER = offsetof(Slot, data);
+const size_t BATCH_SIZE = CO_CAN_CAPTURE_BATCH_SECTORS * CO_CAN_CAPTURE_SECTOR_SIZE;
+
+const uint32_t FLAG_STOP = 0x01U; // To the writer task
+const uint32_t FLAG_STOPPED = 0x02U; // To the task waiting in CO_CANcaptureStop()
+
+LogRing<CO_CAN_CAPTURE_RING_SIZE> ring;
+std::atomic<bool> enabled(false); // Interrupts queue frames
+std::atomic<bool> fileOpen(false); // The writer task owns the file and everything below
+std::atomic<uint32_t> lost(0); // Frames dropped since the last gap record
+osThreadId_t taskHandle = NULL;
+osThreadId_t stopper = NULL;
+
+FIL file;
+/* Records waiting for a full batch, with room for one more past it. Only
+ * whole batches are written while capturing, so the file position stays on
+ * a sector boundary and FatFs hands the buffer straight to the SD DMA. */
+alignas(4) uint8_t batch[BATCH_SIZE + CO_CAN_CAPTURE_RECORD_MAX];
+size_t batchUsed = 0;
+uint64_t last_us = 0; // Time of the last record encoded
+uint32_t syncTime = 0; // osKernelGetTickCount() at the last f_sync()
+CO_CANcaptureStats_t captureStats;
+
+void write(size_t size)
+{
+	UINT written = 0;
+	if (f_write(&file, batch, size, &written) != FR_OK || written != size)
+	{
+		captureStats.writeErrors++;
+	}
+	captureStats.bytes += written;
+	memmove(batch, &batch[size], batchUsed - size);
+	batchUsed -= size;
+}
+
+void append(const CO_CANcaptureRecord_t *record)
+{
+	batchUsed += CO_CANcaptureEncode(&batch[batchUsed], record, &last_us);
+	if (batchUsed >= BATCH_SIZE)
+	{
+		write(BATCH_SIZE);
+	}
+}
+
+// Moves the ring into the batch, followed by a gap record if frames were lost
+void drain()
+{
+	CO_CANcaptureRecord_t record;
+	const uint8_t *data;
+	size_t length;
+
+	while ((data = ring.peek(&length)) != nullptr)
+	{
+		Slot slot;
+		memcpy(&slot, data, length);
+		ring.pop();
+
+		// Frames are queued out of order by a few microseconds at most
+		record.timestamp_us = last_us + (int64_t) (int32_t) (slot.time_us - (uint32_t) last_us);
+		record.ident = slot.ident;
+		record.flags = slot.flags;
+		record.DLC = slot.DLC;
+		memcpy(record.data, slot.data, length - SLOT_HEADER);
+		append(&record);
+		captureStats.frames++;
+	}
+
+	uint32_t dropped = lost.exchange(0, std::memory_order_relaxed);
+	captureStats.lost += dropped;
+	while (dropped > 0U)
+	{
+		record.timestamp_us = last_us;
+		record.ident = (uint16_t) ((dropped > 0xFFFFU) ? 0xFFFFU : dropped);
+		record.flags = CO_CAN_CAPTURE_GAP;
+		record.DLC = 0U;
+		append(&record);
+		dropped -= record.ident;
+	}
+	captureStats.ringHighWater = (uint16_t) ring.highWater();
+}
+
+void captureTask(void *argument)
+{
+	(void) argument;
+
+	for (;;)
+	{
+		const uint32_t flags = osThreadFlagsWait(FLAG_STOP, osFlagsWaitAny,
+				CO_CAN_CAPTURE_PERIOD_MS);
+		if (!fileOpen.load(std::memory_order_acquire))
+		{
+			continue;
+		}
+		drain();
+
+		if ((flags & osFlagsError) == 0U && (flags & FLAG_STOP) != 0U)
+		{
+			enabled.store(false, std::memory_order_relaxed);
+			drain();
+			if (batchUsed > 0U)
+			{
+				write(batchUsed);
+			}
+			if (f_close(&file) != FR_OK)
+			{
+				captureStats.writeErrors++;
+			}
+			captureStats.active = false;
+			fileOpen.store(false, std::memory_order_release);
+			osThreadFlagsSet(stopper, FLAG_STOPPED);
+		}
+		else if (osKernelGetTickCount() - syncTime >= CO_CAN_CAPTURE_SYNC_MS)
+		{
+			// Whole sectors go out now, the tail waits to keep writes aligned
+			const size_t sectors = batchUsed
+					- batchUsed % CO_CAN_CAPTURE_SECTOR_SIZE;
+			if (sectors > 0U)
+			{
+				write(sectors);
+			}
+			if (f_sync(&file) != FR_OK)
+			{
+				captureStats.writeErrors++;
+			}
+			syncTime = osKernelGetTickCount();
+		}
+	}
+}
+
+} // namespace
+
+bool CO_CANcaptureStart(const char *path, uint16_t CANbitRate)
+{
+	if (fileOpen.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	if (taskHandle == NULL)
+	{
+		static const osThreadAttr_t captureTask_attributes =
+		{ .name = "CANcapture", .stack_size = CO_CAN_CAPTURE_TASK_STACK_SIZE,
+				.priority = (osPriority_t) CO_CAN_CAPTURE_TASK_PRIORITY, };
+		taskHandle = osThreadNew(captureTask, NULL, &captureTask_attributes);
+		if (taskHandle == NULL)
+		{
+			return false;
+		}
+	}
+	if (f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+	{
+		return false;
+	}
+
+	// Frames queued after the last capture stopped
+	size_t length;
+	while (ring.peek(&length) != nullptr)
+	{
+		ring.pop();
+	}
+	lost.store(0, std::memory_order_relaxed);
+	memset(&captureStats, 0, sizeof(captureStats));
+
+	const CO_CANcaptureHeader_t header =
+	{ .magic = CO_CAN_CAPTURE_MAGIC, .version = CO_CAN_CAPTURE_VERSION,
+			.bitRate = CANbitRate, .start_us = CO_CANtime_us(), };
+	memcpy(batch, &header, sizeof(header));
+	batchUsed = sizeof(header);
+	last_us = header.start_us;
+	syncTime = osKernelGetTickCount();
+	captureStats.active = true;
+
+	fileOpen.store(true, std::memory_order_release);
+	enabled.store(true, std::memory_order_release);
+	return true;
+}
+
+void CO_CANcaptureStop(void)
+{
+	if (!fileOpen.load(std::memory_order_acquire))
+	{
+		return;
+	}
+	stopper = osThreadGetId();
+	osThreadFlagsSet(taskHandle, FLAG_STOP);
+	osThreadFlagsWait(FLAG_STOPPED, osFlagsWaitAny, osWaitForever);
+}
+
+void CO_CANcaptureGetStats(CO_CANcaptureStats_t *stats)
+{
+	*stats = captureStats;
+	stats->lost += lost.load(std::memory_order_relaxed);
+}
+
+void CO_CANcaptureFrame(uint16_t ident, uint8_t flags, uint8_t DLC, const uint8_t data[],
+		uint64_t timestamp_us)
+{
+	if (!enabled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+	uint8_t *p = ring.reserve(sizeof(Slot));
+	if (p == nullptr)
+	{
+		lost.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	const size_t bytes = ((flags & CO_CAN_CAPTURE_RTR) != 0U) ? 0U : ((DLC > 8U) ? 8U : DLC);
+	Slot slot;
+	slot.time_us = (uint32_t) timestamp_us;
+	slot.ident = ident;
+	slot.flags = flags;
+	slot.DLC = DLC;
+	memcpy(slot.data, data, bytes);
+	memcpy(p, &slot, SLOT_HEADER + bytes);
+	ring.commit(p, SLOT_HEADER + bytes);
+}
+
+#endif /* CO_CAN_CAPTURE */
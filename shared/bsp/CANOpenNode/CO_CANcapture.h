@@ -0,0 +1,70 @@
+/*
+ * CO_CANcapture.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_BSP_CANOPENNODE_CO_CANCAPTURE_H_
+#define SRC_SHARED_BSP_CANOPENNODE_CO_CANCAPTURE_H_
+
+#include <stdint.h>
+
+#include "bsp/CANOpenNode/CO_CANcaptureFormat.h"
+
+/* Field capture of the CAN traffic to the SD card, enabled with CO_CAN_CAPTURE
+ * in the driver. The receive and transmit interrupts append every frame with
+ * its CO_CANtime_us() timestamp to a RAM ring; a task moves the ring into the
+ * file in the CO_CANcaptureFormat.h layout, writing whole sectors. The
+ * application mounts the card through FatFs before starting a capture. */
+
+/* RAM ring between the interrupts and the writer task, a power of two up to
+ * 16 KiB. A full 8 byte frame takes 20 bytes, so 16 KiB holds about 100 ms of
+ * a saturated 1 Mbit/s bus, which is what a slow card write must fit in. */
+#ifndef CO_CAN_CAPTURE_RING_SIZE
+#define CO_CAN_CAPTURE_RING_SIZE 0x4000
+#endif
+/* Sectors written to the card at once, each f_write() covers this many */
+#ifndef CO_CAN_CAPTURE_BATCH_SECTORS
+#define CO_CAN_CAPTURE_BATCH_SECTORS 8
+#endif
+#define CO_CAN_CAPTURE_SECTOR_SIZE 512
+/* Writer task period (ms), the ring must hold the traffic of one period */
+#ifndef CO_CAN_CAPTURE_PERIOD_MS
+#define CO_CAN_CAPTURE_PERIOD_MS 20
+#endif
+/* Interval at which the directory entry is updated (ms), bounds what a power
+ * loss takes with it */
+#ifndef CO_CAN_CAPTURE_SYNC_MS
+#define CO_CAN_CAPTURE_SYNC_MS 1000
+#endif
+#ifndef CO_CAN_CAPTURE_TASK_PRIORITY
+#define CO_CAN_CAPTURE_TASK_PRIORITY osPriorityBelowNormal
+#endif
+#ifndef CO_CAN_CAPTURE_TASK_STACK_SIZE
+#define CO_CAN_CAPTURE_TASK_STACK_SIZE (512 * 4)
+#endif
+
+typedef struct {
+	uint32_t frames; /* Frames written to the file */
+	uint32_t lost; /* Frames dropped because the ring was full */
+	uint32_t bytes; /* File size so far */
+	uint16_t ringHighWater; /* Most bytes queued in the ring at once */
+	uint16_t writeErrors; /* Failed f_write() or f_sync() calls */
+	bool active;
+} CO_CANcaptureStats_t;
+
+/* Starts capturing into a new file at path, replacing an existing one.
+ * CANbitRate (kbit/s) is recorded in the file header. Returns false if a
+ * capture is already running or the file can't be created. */
+bool CO_CANcaptureStart(const char *path, uint16_t CANbitRate);
+/* Writes out what is queued and closes the file, waits for the writer task */
+void CO_CANcaptureStop(void);
+void CO_CANcaptureGetStats(CO_CANcaptureStats_t *stats);
+
+/* Queues one frame, called by the driver from its interrupts. flags holds
+ * CO_CAN_CAPTURE_TX, _RTR and _CAN2. */
+void CO_CANcaptureFrame(uint16_t ident, uint8_t flags, uint8_t DLC, const uint8_t data[],
+		uint64_t timestamp_us);
+
+#endif /* SRC_SHARED_BSP_CANOPENNODE_CO_CANCAPTURE_H_ */
@@ -0,0 +1,125 @@
+/*
+ * CO_CANcaptureFormat.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_BSP_CANOPENNODE_CO_CANCAPTUREFORMAT_H_
+#define SRC_SHARED_BSP_CANOPENNODE_CO_CANCAPTUREFORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Capture file layout, shared by the recorder (CO_CANcapture.h) and the host
+ * replay (CO_CANreplay.h).
+ *
+ * The file starts with a CO_CANcaptureHeader_t, little endian, followed by one
+ * record per frame:
+ *   u8      flags (CO_CAN_CAPTURE_xxx) | DLC
+ *   u16     COB-ID, little endian
+ *   varint  time since the previous record in microseconds, zigzag encoded
+ *           because frames from different interrupts may be slightly out of
+ *           order. The first record counts from start_us in the header.
+ *   DLC data bytes, none for RTR frames
+ * A gap record has CO_CAN_CAPTURE_GAP set and holds the number of frames lost
+ * to a full capture ring in place of the COB-ID, without data. */
+
+#define CO_CAN_CAPTURE_MAGIC 0x50414343UL /* "CCAP" */
+#define CO_CAN_CAPTURE_VERSION 1U
+
+#define CO_CAN_CAPTURE_DLC 0x0FU
+#define CO_CAN_CAPTURE_TX 0x10U /* Sent by the capturing node */
+#define CO_CAN_CAPTURE_RTR 0x20U
+#define CO_CAN_CAPTURE_CAN2 0x40U /* Seen on the second CAN module */
+#define CO_CAN_CAPTURE_GAP 0x80U
+
+/* Longest encoded record: flags, COB-ID, 64-bit varint and data */
+#define CO_CAN_CAPTURE_RECORD_MAX (1U + 2U + 10U + 8U)
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t bitRate; /* kbit/s */
+	uint64_t start_us; /* Capture timebase when recording started */
+} CO_CANcaptureHeader_t;
+
+typedef struct {
+	uint64_t timestamp_us;
+	uint16_t ident; /* COB-ID, or frames lost for a gap record */
+	uint8_t flags; /* CO_CAN_CAPTURE_xxx without the DLC */
+	uint8_t DLC;
+	uint8_t data[8];
+} CO_CANcaptureRecord_t;
+
+/* Appends record to out (at least CO_CAN_CAPTURE_RECORD_MAX bytes), returns
+ * the bytes written. last_us holds the time of the previous record. */
+static inline size_t CO_CANcaptureEncode(uint8_t *out, const CO_CANcaptureRecord_t *record,
+		uint64_t *last_us)
+{
+	const int64_t delta = (int64_t) (record->timestamp_us - *last_us);
+	uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+	const uint8_t DLC = (record->DLC > 8U) ? 8U : record->DLC;
+	size_t n = 0U;
+
+	out[n++] = (uint8_t) ((record->flags & ~CO_CAN_CAPTURE_DLC) | DLC);
+	out[n++] = (uint8_t) record->ident;
+	out[n++] = (uint8_t) (record->ident >> 8);
+	while (zigzag >= 0x80U)
+	{
+		out[n++] = (uint8_t) (zigzag | 0x80U);
+		zigzag >>= 7;
+	}
+	out[n++] = (uint8_t) zigzag;
+	if ((record->flags & (CO_CAN_CAPTURE_RTR | CO_CAN_CAPTURE_GAP)) == 0U)
+	{
+		memcpy(&out[n], record->data, DLC);
+		n += DLC;
+	}
+	*last_us = record->timestamp_us;
+	return n;
+}
+
+/* Reads one record from in, returns the bytes used or 0 if size does not
+ * hold a complete record */
+static inline size_t CO_CANcaptureDecode(const uint8_t *in, size_t size,
+		CO_CANcaptureRecord_t *record, uint64_t *last_us)
+{
+	uint64_t zigzag = 0U;
+	size_t n = 3U;
+	uint8_t shift = 0U;
+
+	if (size < 4U)
+	{
+		return 0U;
+	}
+	record->flags = (uint8_t) (in[0] & ~CO_CAN_CAPTURE_DLC);
+	record->DLC = (uint8_t) (in[0] & CO_CAN_CAPTURE_DLC);
+	record->ident = (uint16_t) (in[1] | (in[2] << 8));
+	do
+	{
+		if (n >= size || shift > 63U)
+		{
+			return 0U;
+		}
+		zigzag |= (uint64_t) (in[n] & 0x7FU) << shift;
+		shift += 7U;
+	} while ((in[n++] & 0x80U) != 0U);
+
+	const uint8_t bytes = ((record->flags & (CO_CAN_CAPTURE_RTR | CO_CAN_CAPTURE_GAP)) != 0U
+			|| record->DLC > 8U) ? 0U : record->DLC;
+	if (n + bytes > size)
+	{
+		return 0U;
+	}
+	memcpy(record->data, &in[n], bytes);
+	n += bytes;
+
+	const int64_t delta = (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1U);
+	record->timestamp_us = *last_us + (uint64_t) delta;
+	*last_us = record->timestamp_us;
+	return n;
+}
+
+#endif /* SRC_SHARED_BSP_CANOPENNODE_CO_CANCAPTUREFORMAT_H_ */
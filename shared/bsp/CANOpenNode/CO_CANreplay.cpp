@@ -0,0 +1,151 @@
+/*
+ * CO_CANreplay.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#include <string.h>
+
+#include "bsp/CANOpenNode/CO_CANreplay.h"
+
+/* Decodes up to the next frame that belongs to this replay */
+static void CO_CANreplayAdvance(CO_CANreplay_t *replay)
+{
+	replay->nextValid = false;
+	while (replay->pos < replay->size)
+	{
+		CO_CANcaptureRecord_t *record = &replay->next;
+		const size_t used = CO_CANcaptureDecode(&replay->capture[replay->pos],
+				replay->size - replay->pos, record, &replay->last_us);
+		if (used == 0U)
+		{
+			/* Truncated by a power loss, the rest can't be decoded */
+			replay->pos = replay->size;
+			break;
+		}
+		replay->pos += used;
+
+		if ((record->flags & CO_CAN_CAPTURE_GAP) != 0U)
+		{
+			replay->lost += record->ident;
+		}
+		else if ((record->flags & CO_CAN_CAPTURE_CAN2) == replay->channel
+				&& (replay->includeTx || (record->flags & CO_CAN_CAPTURE_TX) == 0U))
+		{
+			replay->nextValid = true;
+			break;
+		}
+	}
+}
+
+CO_ReturnError_t CO_CANreplay_init(CO_CANreplay_t *replay, CO_CANvirtualBus_t *bus,
+		const uint8_t *capture, size_t size, uint8_t channel, bool_t includeTx,
+		float64_t speed)
+{
+	CO_CANcaptureHeader_t header;
+
+	if (replay == NULL || bus == NULL || capture == NULL || size < sizeof(header)
+			|| speed < 0.0)
+	{
+		return CO_ERROR_ILLEGAL_ARGUMENT;
+	}
+	memcpy(&header, capture, sizeof(header));
+	if (header.magic != CO_CAN_CAPTURE_MAGIC || header.version != CO_CAN_CAPTURE_VERSION)
+	{
+		return CO_ERROR_ILLEGAL_ARGUMENT;
+	}
+
+	CO_ReturnError_t err = CO_CANmodule_init(&replay->CANmodule, bus, replay->rxArray, 1U,
+			replay->txArray, CO_CAN_REPLAY_TX_SIZE, header.bitRate);
+	if (err != CO_ERROR_NO)
+	{
+		return err;
+	}
+	CO_CANsetNormalMode(&replay->CANmodule);
+
+	replay->capture = capture;
+	replay->size = size;
+	replay->pos = sizeof(header);
+	replay->last_us = header.start_us;
+	replay->started = false;
+	replay->speed = speed;
+	replay->channel = (uint8_t) (channel & CO_CAN_CAPTURE_CAN2);
+	replay->includeTx = includeTx;
+	replay->frames = 0U;
+	replay->lost = 0U;
+	replay->maxLate_us = 0U;
+	CO_CANreplayAdvance(replay);
+	return CO_ERROR_NO;
+}
+
+bool_t CO_CANreplay_process(CO_CANreplay_t *replay)
+{
+	CO_CANmodule_t *CANmodule = &replay->CANmodule;
+	const uint64_t now_us = CO_CANvirtualBus_time_us((CO_CANvirtualBus_t*) CANmodule->CANptr);
+
+	while (replay->nextValid)
+	{
+		const CO_CANcaptureRecord_t *record = &replay->next;
+		if (!replay->started)
+		{
+			replay->captureStart_us = record->timestamp_us;
+			replay->busStart_us = now_us;
+			replay->started = true;
+		}
+
+		uint64_t due_us = replay->busStart_us;
+		if (replay->speed > 0.0 && record->timestamp_us > replay->captureStart_us)
+		{
+			due_us += (uint64_t) ((float64_t) (record->timestamp_us - replay->captureStart_us)
+					/ replay->speed);
+		}
+		if (due_us > now_us)
+		{
+			break;
+		}
+
+		/* A free buffer, unless the same COB-ID is still waiting */
+		const bool_t rtr = ((record->flags & CO_CAN_CAPTURE_RTR) != 0U) ? true : false;
+		const uint32_t ident = ((uint32_t) (record->ident & 0x07FFU) << 1) | (rtr ? 1U : 0U);
+		CO_CANtx_t *idle = NULL;
+		bool_t blocked = false;
+		for (uint16_t i = 0U; i < CO_CAN_REPLAY_TX_SIZE; i++)
+		{
+			CO_CANtx_t *buffer = &replay->txArray[i];
+			if (buffer->bufferFull)
+			{
+				blocked = (buffer->ident == ident) ? true : blocked;
+			}
+			else if (idle == NULL)
+			{
+				idle = buffer;
+			}
+		}
+		if (idle == NULL || blocked)
+		{
+			break;
+		}
+
+		CO_CANtx_t *buffer = CO_CANtxBufferInit(CANmodule, (uint16_t) (idle - replay->txArray),
+				record->ident, rtr, record->DLC, false);
+		memcpy(buffer->data, record->data, sizeof(buffer->data));
+		CO_CANsend(CANmodule, buffer);
+		replay->frames++;
+		if (replay->speed > 0.0 && now_us - due_us > replay->maxLate_us)
+		{
+			replay->maxLate_us = now_us - due_us;
+		}
+		CO_CANreplayAdvance(replay);
+	}
+
+	return (replay->nextValid || CANmodule->CANtxCount > 0U) ? true : false;
+}
+
+void CO_CANreplay_delete(CO_CANreplay_t *replay)
+{
+	if (replay != NULL)
+	{
+		CO_CANmodule_disable(&replay->CANmodule);
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * CO_CANreplay.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_BSP_CANOPENNODE_CO_CANREPLAY_H_
+#define SRC_SHARED_BSP_CANOPENNODE_CO_CANREPLAY_H_
+
+#include "301/CO_driver.h"
+#include "bsp/CANOpenNode/CO_CANcaptureFormat.h"
+
+/* Host replay of a capture (see CO_CANcapture.h) into the virtual bus, built
+ * with CO_DRIVER_VIRTUAL. The replay attaches its own module to the bus and
+ * sends the captured frames at their original spacing divided by speed, or
+ * back to back with speed 0. Frames are queued by CO_CANreplay_process() and
+ * take part in arbitration from the next CO_CANvirtualBus_run(), so the step
+ * of the bus clock bounds how closely the original timing is kept. Frames
+ * with the same COB-ID leave in capture order. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frames the replay can have queued on the bus at once */
+#ifndef CO_CAN_REPLAY_TX_SIZE
+#define CO_CAN_REPLAY_TX_SIZE 16
+#endif
+
+typedef struct {
+    CO_CANmodule_t CANmodule;
+    CO_CANrx_t rxArray[1];
+    CO_CANtx_t txArray[CO_CAN_REPLAY_TX_SIZE];
+    const uint8_t *capture;
+    size_t size;
+    size_t pos; /* Offset of the record after next */
+    uint64_t last_us; /* Decoder state */
+    CO_CANcaptureRecord_t next; /* Next frame to send */
+    bool_t nextValid;
+    uint64_t captureStart_us; /* Timestamp of the first frame replayed */
+    uint64_t busStart_us; /* Bus clock when the first frame was due */
+    bool_t started;
+    float64_t speed;
+    uint8_t channel; /* 0 for CAN1, CO_CAN_CAPTURE_CAN2 */
+    bool_t includeTx;
+    uint32_t frames; /* Frames queued on the bus */
+    uint32_t lost; /* Frames the capture itself is missing, from gap records */
+    uint64_t maxLate_us; /* Longest a frame waited past its due time, not kept with speed 0 */
+} CO_CANreplay_t;
+
+/* Prepares replaying capture (size bytes, kept by the caller) on bus. Only
+ * frames seen on channel are sent, and the frames the capturing node sent
+ * itself only with includeTx, leave them out when the stack under test takes
+ * its place. The bus must run at the bit rate of the capture
+ * (CO_ERROR_ILLEGAL_BAUDRATE), a malformed header gives
+ * CO_ERROR_ILLEGAL_ARGUMENT. */
+CO_ReturnError_t CO_CANreplay_init(CO_CANreplay_t *replay, CO_CANvirtualBus_t *bus,
+        const uint8_t *capture, size_t size, uint8_t channel, bool_t includeTx,
+        float64_t speed);
+/* Queues the frames that are due at the bus clock, returns false once every
+ * frame has been sent */
+bool_t CO_CANreplay_process(CO_CANreplay_t *replay);
+/* Detaches the replay module from the bus */
+void CO_CANreplay_delete(CO_CANreplay_t *replay);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SRC_SHARED_BSP_CANOPENNODE_CO_CANREPLAY_H_ */
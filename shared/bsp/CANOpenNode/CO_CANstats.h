@@ -0,0 +1,45 @@
+/*
+ * CO_CANstats.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_BSP_CANOPENNODE_CO_CANSTATS_H_
+#define SRC_SHARED_BSP_CANOPENNODE_CO_CANSTATS_H_
+
+#include "301/CO_driver.h"
+#include "301/CO_ODinterface.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sub-indexes of the manufacturer statistics record, all UNSIGNED32 read-only.
+ * Sub-index 0 holds the highest sub-index as usual. */
+typedef enum {
+    CO_CAN_STATS_OD_RX_FRAMES = 1,
+    CO_CAN_STATS_OD_TX_FRAMES = 2,
+    CO_CAN_STATS_OD_RX_BYTES = 3,
+    CO_CAN_STATS_OD_TX_BYTES = 4,
+    CO_CAN_STATS_OD_MAILBOX_FULL = 5,
+    CO_CAN_STATS_OD_BUS_LOAD = 6, /* 0.01 % */
+    CO_CAN_STATS_OD_RX_OVERFLOWS = 7,
+    CO_CAN_STATS_OD_RX_ISR_MAX = 8, /* CPU cycles */
+    CO_CAN_STATS_OD_TX_ISR_MAX = 9,
+    CO_CAN_STATS_OD_RX_CLASS = 10, /* 10..17, one per CO_CANclass_t */
+    CO_CAN_STATS_OD_TX_CLASS = 10 + CO_CAN_CLASS_COUNT, /* 18..25 */
+    CO_CAN_STATS_OD_COUNT = 10 + 2 * CO_CAN_CLASS_COUNT
+} CO_CANstatsOD_t;
+
+/* Serves the statistics of CANmodule through a manufacturer record in the
+ * Object Dictionary, e.g. OD_ENTRY_H2100 with sub-indexes up to 25. The
+ * extension must stay valid as long as the entry is used. */
+CO_ReturnError_t CO_CANstatsInitOD(CO_CANmodule_t *CANmodule, OD_entry_t *entry,
+        OD_extension_t *extension);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_SHARED_BSP_CANOPENNODE_CO_CANSTATS_H_ */
@@ -0,0 +1,180 @@
+/*
+ * CO_ODvar.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_BSP_CANOPENNODE_CO_ODVAR_H_
+#define SRC_SHARED_BSP_CANOPENNODE_CO_ODVAR_H_
+
+#include <cstdint>
+#include <type_traits>
+
+#include "301/CO_ODinterface.h"
+
+/*!
+ \brief Typed accessor of one Object Dictionary variable.
+
+ Index, sub-index and type are part of the accessor type, so the lookup done by every
+ OD_get_u32()/OD_set_f32() call happens once, in bind(). While the entry has no extension,
+ get() and set() then read and write the variable in its original location directly, one
+ load or store. Once an extension is registered with OD_extension_init(), even after binding,
+ the same calls go through its OD_IO_t read/write like OD_get_value() with odOrig false.
+
+ As with OD_get_value(), access is not locked: take CO_LOCK_OD() where another task may
+ write the variable at the same time, types wider than 32 bits are not read in one access.
+ Writing does not request TPDOs, call OD_requestTPDO() where that is wanted.
+
+ \code
+ static ODvar<0x6000, 1, float32_t> temperature;
+ temperature.bind(OD_ENTRY_H6000_temperature);
+ ...
+ temperature = sample;
+ \endcode
+
+ \tparam Index Index of the entry, checked against the entry bound.
+ \tparam SubIndex Sub-index of the variable.
+ \tparam T Type of the variable, its size must match the data length in the dictionary.
+ */
+template<uint16_t Index, uint8_t SubIndex, typename T>
+class ODvar
+{
+	static_assert(std::is_arithmetic<T>::value, "ODvar holds basic CANopen types only");
+	static_assert(sizeof(T) <= 8U, "ODvar holds basic CANopen types only");
+
+public:
+	static constexpr uint16_t index = Index;
+	static constexpr uint8_t subIndex = SubIndex;
+
+	constexpr ODvar() :
+			_entry(nullptr), _data(nullptr)
+	{
+	}
+
+	/*!
+	 \brief Looks the variable up in od, see bind(const OD_entry_t*).
+	 */
+	ODR_t bind(OD_t *od)
+	{
+		return bind(OD_find(od, Index));
+	}
+
+	/*!
+	 \brief Binds the accessor to entry, e.g. OD_ENTRY_H6000 from the generated OD.h.
+	 \return ODR_OK, ODR_IDX_NOT_EXIST if entry is not Index, ODR_SUB_NOT_EXIST, or
+	 ODR_TYPE_MISMATCH if the variable is not sizeof(T) long. The accessor stays unbound
+	 on error.
+	 */
+	ODR_t bind(const OD_entry_t *entry)
+	{
+		OD_IO_t io;
+
+		_entry = nullptr;
+		_data = nullptr;
+		if (entry == nullptr || entry->index != Index)
+		{
+			return ODR_IDX_NOT_EXIST;
+		}
+		ODR_t ret = OD_getSub(entry, SubIndex, &io, true);
+		if (ret != ODR_OK)
+		{
+			return ret;
+		}
+		if (io.stream.dataLength != sizeof(T))
+		{
+			return ODR_TYPE_MISMATCH;
+		}
+		/* Variables the extension serves alone, or misaligned ones, always take the slow path */
+		if (io.stream.dataOrig != nullptr
+				&& ((uintptr_t) io.stream.dataOrig % alignof(T)) == 0U)
+		{
+			_data = static_cast<T*>(io.stream.dataOrig);
+		}
+		_entry = entry;
+		return ODR_OK;
+	}
+
+	bool bound() const
+	{
+		return _entry != nullptr;
+	}
+
+	/*!
+	 \brief Reads the variable, 0 if unbound or the extension refuses.
+	 */
+	T get() const
+	{
+		if (_data != nullptr && _entry->extension == nullptr)
+		{
+			return *static_cast<volatile T*>(_data);
+		}
+		T value = 0;
+		read(value);
+		return value;
+	}
+
+	/*!
+	 \brief Writes the variable, ignored if unbound or the extension refuses.
+	 */
+	void set(T value)
+	{
+		if (_data != nullptr && _entry->extension == nullptr)
+		{
+			*static_cast<volatile T*>(_data) = value;
+			return;
+		}
+		write(value);
+	}
+
+	/*!
+	 \brief Reads the variable, reporting why it could not.
+	 */
+	ODR_t read(T &value) const
+	{
+		if (_entry == nullptr)
+		{
+			return ODR_IDX_NOT_EXIST;
+		}
+		if (_data != nullptr && _entry->extension == nullptr)
+		{
+			value = *static_cast<volatile T*>(_data);
+			return ODR_OK;
+		}
+		return OD_get_value(_entry, SubIndex, &value, sizeof(T), false);
+	}
+
+	/*!
+	 \brief Writes the variable, reporting why it could not.
+	 */
+	ODR_t write(T value)
+	{
+		if (_entry == nullptr)
+		{
+			return ODR_IDX_NOT_EXIST;
+		}
+		if (_data != nullptr && _entry->extension == nullptr)
+		{
+			*static_cast<volatile T*>(_data) = value;
+			return ODR_OK;
+		}
+		return OD_set_value(_entry, SubIndex, &value, sizeof(T), false);
+	}
+
+	operator T() const
+	{
+		return get();
+	}
+
+	ODvar& operator=(T value)
+	{
+		set(value);
+		return *this;
+	}
+
+private:
+	const OD_entry_t *_entry;
+	T *_data; /* Original location, nullptr if there is none usable */
+};
+
+#endif /* SRC_SHARED_BSP_CANOPENNODE_CO_ODVAR_H_ */
@@ -0,0 +1,125 @@
+/*
+ * CO_crc16_stm32.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#include "301/CO_driver.h"
+#include "301/crc16-ccitt.h"
+
+#if ((CO_CONFIG_CRC16) & CO_CONFIG_CRC16_ENABLE) && ((CO_CONFIG_CRC16) & CO_CONFIG_CRC16_EXTERNAL)
+
+#include <atomic>
+
+#include "main.h"
+#include "cmsis_os.h"
+
+/* crc16_ccitt() on the CRC unit, programmed for the 16-bit polynomial 0x1021
+ * without reflection. The unit is claimed per call; whoever finds it taken,
+ * another task or an interrupt, computes in software instead of waiting. */
+
+static std::atomic_flag CO_CRC16busy = ATOMIC_FLAG_INIT;
+
+#ifdef CO_CRC16_DMA
+extern DMA_HandleTypeDef CO_CRC16_DMA;
+
+#define CO_CRC16_DMA_FLAG 0x01U
+/* A transfer of at most 64 KiB takes about 1 ms */
+#define CO_CRC16_DMA_TIMEOUT_MS 10U
+static osThreadId_t CO_CRC16waiting = NULL;
+
+static void CO_CRC16dmaDone(DMA_HandleTypeDef *hdma)
+{
+	(void) hdma;
+	osThreadFlagsSet(CO_CRC16waiting, CO_CRC16_DMA_FLAG);
+}
+
+/* Feeds block by DMA and sleeps until it is done, returns false if the
+ * transfer could not be made */
+static bool_t CO_CRC16feedDMA(const uint8_t *block, size_t length)
+{
+	CO_CRC16waiting = osThreadGetId();
+	CO_CRC16_DMA.XferCpltCallback = CO_CRC16dmaDone;
+	CO_CRC16_DMA.XferErrorCallback = CO_CRC16dmaDone;
+	osThreadFlagsClear(CO_CRC16_DMA_FLAG);
+	if (HAL_DMA_Start_IT(&CO_CRC16_DMA, (uint32_t) block, (uint32_t) &CRC->DR,
+			(uint32_t) length) != HAL_OK)
+	{
+		return false;
+	}
+	const uint32_t flags = osThreadFlagsWait(CO_CRC16_DMA_FLAG, osFlagsWaitAny,
+			CO_CRC16_DMA_TIMEOUT_MS);
+	if ((flags & osFlagsError) != 0U)
+	{
+		HAL_DMA_Abort(&CO_CRC16_DMA);
+		return false;
+	}
+	return (CO_CRC16_DMA.ErrorCode == HAL_DMA_ERROR_NONE) ? true : false;
+}
+#endif
+
+/* Starts a calculation that continues from crc */
+static void CO_CRC16start(uint16_t crc)
+{
+	__HAL_RCC_CRC_CLK_ENABLE();
+	CRC->POL = 0x1021U;
+	CRC->CR = CRC_CR_POLYSIZE_0; /* 16-bit polynomial, input and output as is */
+	CRC->INIT = crc;
+	CRC->CR |= CRC_CR_RESET;
+}
+
+/* The unit shifts each write in from its most significant bit, so whole words
+ * are byte swapped to keep the order of the bytes in memory */
+static void CO_CRC16feed(const uint8_t *block, size_t length)
+{
+	while (length > 0U && ((uintptr_t) block & 3U) != 0U)
+	{
+		*(__IO uint8_t*) &CRC->DR = *block++;
+		length--;
+	}
+	for (; length >= 4U; length -= 4U, block += 4U)
+	{
+		CRC->DR = __REV(*(const uint32_t*) block);
+	}
+	while (length > 0U)
+	{
+		*(__IO uint8_t*) &CRC->DR = *block++;
+		length--;
+	}
+}
+
+void crc16_ccitt_single(uint16_t *crc, const uint8_t chr)
+{
+	*crc = crc16_ccitt_sw(&chr, 1U, *crc);
+}
+
+uint16_t crc16_ccitt(const uint8_t block[], size_t blockLength, uint16_t crc)
+{
+	if (blockLength < CO_CRC16_HW_MIN || CO_CRC16busy.test_and_set(std::memory_order_acquire))
+	{
+		return crc16_ccitt_sw(block, blockLength, crc);
+	}
+
+	CO_CRC16start(crc);
+#ifdef CO_CRC16_DMA
+	if (blockLength >= CO_CRC16_DMA_MIN && blockLength <= 0xFFFFU && __get_IPSR() == 0U
+			&& osKernelGetState() == osKernelRunning)
+	{
+		if (!CO_CRC16feedDMA(block, blockLength))
+		{
+			CO_CRC16busy.clear(std::memory_order_release);
+			return crc16_ccitt_sw(block, blockLength, crc);
+		}
+	}
+	else
+#endif
+	{
+		CO_CRC16feed(block, blockLength);
+	}
+	crc = (uint16_t) CRC->DR;
+	CO_CRC16busy.clear(std::memory_order_release);
+	return crc;
+}
+
+#endif /* CO_CONFIG_CRC16_EXTERNAL */
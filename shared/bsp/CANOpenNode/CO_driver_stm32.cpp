@@ -25,13 +25,655 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include "301/CO_driver.h"
 #include "can.h"
 #include "main.h"
+#include "cmsis_os.h"
 #include "CANopen.h"
+#include "bsp/CANOpenNode/CO_CANstats.h"
+#if CO_CAN_CAPTURE
+#include "bsp/CANOpenNode/CO_CANcapture.h"
+#endif
+
+/* Initialized modules, the HAL callbacks find theirs by CAN handle */
+static CO_CANmodule_t* CO_CANmodules[CO_CAN_MODULES_MAX];
+
+/* Receive task, woken by CO_CAN_RXISR() with CO_CAN_RX_FLAG */
+#define CO_CAN_RX_FLAG 0x01U
+static osThreadId_t CO_CANrxTaskHandle = NULL;
+static void CO_CANrxTask(void *argument);
+
+static CO_CANmodule_t* CO_CANmoduleOf(const CAN_HandleTypeDef *hcan)
+{
+	for (uint8_t i = 0U; i < CO_CAN_MODULES_MAX; i++)
+	{
+		CO_CANmodule_t *CANmodule = CO_CANmodules[i];
+		if (CANmodule != NULL && CANmodule->CANptr == hcan)
+		{
+			return CANmodule;
+		}
+	}
+	return NULL;
+}
+
+/* Takes over the slot of a module previously initialized on the same
+ * controller, returns false if all slots serve other controllers */
+static bool_t CO_CANregister(CO_CANmodule_t *CANmodule)
+{
+	int16_t slot = -1;
+	for (uint8_t i = 0U; i < CO_CAN_MODULES_MAX; i++)
+	{
+		if (CO_CANmodules[i] == CANmodule
+				|| (CO_CANmodules[i] != NULL && CO_CANmodules[i]->CANptr == CANmodule->CANptr))
+		{
+			CO_CANmodules[i] = NULL;
+		}
+		if (CO_CANmodules[i] == NULL && slot < 0)
+		{
+			slot = (int16_t) i;
+		}
+	}
+	if (slot < 0)
+	{
+		return false;
+	}
+	CO_CANmodules[slot] = CANmodule;
+	return true;
+}
+
+static void CO_CANunregister(const CO_CANmodule_t *CANmodule)
+{
+	for (uint8_t i = 0U; i < CO_CAN_MODULES_MAX; i++)
+	{
+		if (CO_CANmodules[i] == CANmodule)
+		{
+			CO_CANmodules[i] = NULL;
+		}
+	}
+}
+
+/* Puts all interrupts of a controller at the priority CubeMX gave its FIFO 0
+ * interrupt. They share rxQueue, the receive timebase and the statistics, and
+ * must not preempt each other. */
+static void CO_CANirqPriority(IRQn_Type tx, IRQn_Type rx0, IRQn_Type rx1, IRQn_Type sce)
+{
+	const uint32_t priority = NVIC_GetPriority(rx0);
+	NVIC_SetPriority(tx, priority);
+	NVIC_SetPriority(rx1, priority);
+	NVIC_SetPriority(sce, priority);
+}
+
+/* Timing and mode as generated by CubeMX for the controller */
+static void CO_CANhalInit(const CAN_HandleTypeDef *hcan)
+{
+#if CO_CAN_USE_CAN2
+	if (hcan->Instance == CAN2)
+	{
+		MX_CAN2_Init();
+		CO_CANirqPriority(CAN2_TX_IRQn, CAN2_RX0_IRQn, CAN2_RX1_IRQn, CAN2_SCE_IRQn);
+		return;
+	}
+#else
+	(void) hcan;
+#endif
+	MX_CAN1_Init();
+	CO_CANirqPriority(CAN1_TX_IRQn, CAN1_RX0_IRQn, CAN1_RX1_IRQn, CAN1_SCE_IRQn);
+}
+
+/* Statistics class of a COB-ID, by its function code (bits 10..7) */
+static CO_CANclass_t CO_CANclassOf(uint32_t cobId)
+{
+	static const uint8_t byFunction[16] =
+	{ CO_CAN_CLASS_NMT, CO_CAN_CLASS_EMCY, CO_CAN_CLASS_TIME, CO_CAN_CLASS_PDO,
+			CO_CAN_CLASS_PDO, CO_CAN_CLASS_PDO, CO_CAN_CLASS_PDO, CO_CAN_CLASS_PDO,
+			CO_CAN_CLASS_PDO, CO_CAN_CLASS_PDO, CO_CAN_CLASS_PDO, CO_CAN_CLASS_SDO,
+			CO_CAN_CLASS_SDO, CO_CAN_CLASS_OTHER, CO_CAN_CLASS_HB, CO_CAN_CLASS_OTHER };
+
+	if (cobId == CO_CAN_ID_SYNC)
+	{
+		return CO_CAN_CLASS_SYNC;
+	}
+	if (cobId > CO_CAN_ID_NMT_SERVICE && cobId < CO_CAN_ID_SYNC)
+	{
+		return CO_CAN_CLASS_OTHER;
+	}
+	return (CO_CANclass_t) byFunction[(cobId >> 7) & 0x0FU];
+}
+
+/* Bits of a standard data frame including interframe space, without stuff bits */
+static inline uint32_t CO_CANframeBits(uint32_t dlc)
+{
+	return 47U + 8U * (dlc > 8U ? 8U : dlc);
+}
+
+/* 64-bit CPU cycle count, extends the DWT counter whenever it is read */
+static uint64_t CO_CANcycles(void)
+{
+	static uint32_t high = 0U, last = 0U;
+
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	const uint32_t now = DWT->CYCCNT;
+	if (now < last)
+	{
+		high++;
+	}
+	last = now;
+	const uint64_t cycles = ((uint64_t) high << 32) | now;
+	__set_PRIMASK(primask);
+	return cycles;
+}
+
+uint64_t CO_CANtime_us(void)
+{
+	return CO_CANcycles() / (SystemCoreClock / 1000000U);
+}
+
+/* Start of a received frame in CPU cycles. The TTCM stamp gives the exact
+ * distance to the previous frame, modulo 65536 bit times. The absolute time
+ * comes from the interrupt: a frame cannot have started later than its
+ * length before now, so whenever the mapping says it did the mapping is
+ * moved back. It settles on the shortest interrupt latency seen. */
+static uint64_t CO_CANrxTime(CO_CANmodule_t *CANmodule, const CO_CANrxMsg_t *rcvMsg, uint64_t now)
+{
+	const uint32_t cyclesPerBit = CANmodule->cyclesPerBit;
+	/* SOF up to the end of frame bit where the receiver accepts it */
+	const uint32_t dlc = rcvMsg->RxHeader.DLC > 8U ? 8U : rcvMsg->RxHeader.DLC;
+	const uint64_t latest = now - (uint64_t) (43U + 8U * dlc) * cyclesPerBit;
+
+#if CO_CAN_RX_TIMESTAMP_TTCM
+	const uint16_t stamp = (uint16_t) rcvMsg->RxHeader.Timestamp;
+	if (CANmodule->rxTimeValid && cyclesPerBit > 0U)
+	{
+		/* Bits since the last frame, picking the wrap that lands nearest to now */
+		const uint64_t span = (latest - CANmodule->rxTimeCycles) / cyclesPerBit;
+		const int16_t ahead = (int16_t) ((uint16_t) span - (uint16_t) (stamp - CANmodule->rxTimeBits));
+		uint64_t start = CANmodule->rxTimeCycles + (uint64_t) ((int64_t) span - ahead) * cyclesPerBit;
+		if (start > latest)
+		{
+			start = latest;
+		}
+		CANmodule->rxTimeCycles = start;
+		CANmodule->rxTimeBits = stamp;
+		return start;
+	}
+	CANmodule->rxTimeCycles = latest;
+	CANmodule->rxTimeBits = stamp;
+	CANmodule->rxTimeValid = true;
+#else
+	(void) CANmodule;
+#endif
+	return latest;
+}
+
+#if CO_CAN_CAPTURE
+/* Start of a sent frame in CPU cycles, from the TTCM stamp the controller
+ * stores in the mailbox at its start of frame. Uses the mapping kept by
+ * CO_CANrxTime() without moving it; before the first received frame it
+ * counts back the frame length from now. */
+static uint64_t CO_CANtxTime(const CO_CANmodule_t *CANmodule, uint32_t tdtr, uint64_t now)
+{
+	const uint32_t cyclesPerBit = CANmodule->cyclesPerBit;
+	const uint64_t latest = now - (uint64_t) CO_CANframeBits(tdtr & 0x0FU) * cyclesPerBit;
+
+#if CO_CAN_RX_TIMESTAMP_TTCM
+	if (CANmodule->rxTimeValid && cyclesPerBit > 0U)
+	{
+		const uint64_t span = (latest - CANmodule->rxTimeCycles) / cyclesPerBit;
+		const int16_t ahead = (int16_t) ((uint16_t) span
+				- (uint16_t) ((uint16_t) (tdtr >> 16) - CANmodule->rxTimeBits));
+		const uint64_t start = CANmodule->rxTimeCycles
+				+ (uint64_t) ((int64_t) span - ahead) * cyclesPerBit;
+		return (start > latest) ? latest : start;
+	}
+#else
+	(void) tdtr;
+#endif
+	return latest;
+}
+
+/* Capture channel flag of a controller */
+static inline uint8_t CO_CANcaptureChannel(const CAN_HandleTypeDef *hcan)
+{
+#if CO_CAN_USE_CAN2
+	return (hcan->Instance == CAN2) ? CO_CAN_CAPTURE_CAN2 : 0U;
+#else
+	(void) hcan;
+	return 0U;
+#endif
+}
+#endif
+
+static void CO_CANisrCycles(uint32_t histogram[], uint32_t *max, uint32_t cycles)
+{
+	uint32_t bin = 0U;
+	if (cycles >= 128U)
+	{
+		bin = 31U - __CLZ(cycles) - 6U;
+		if (bin >= CO_CAN_ISR_HISTOGRAM_BINS)
+		{
+			bin = CO_CAN_ISR_HISTOGRAM_BINS - 1U;
+		}
+	}
+	histogram[bin]++;
+	if (cycles > *max)
+	{
+		*max = cycles;
+	}
+}
+
+/* Converts ident or mask as aligned in CO_CANrx_t (STDID << 2 | RTR << 1) to
+ * the 16-bit filter layout (STDID << 5 | RTR << 4 | IDE << 3) */
+static inline uint16_t CO_CANfilter16(uint16_t value)
+{
+	return (uint16_t) (((value >> 2) & 0x07FFU) << 5) | (uint16_t) (((value >> 1) & 0x01U) << 4);
+}
 
-static CO_CANmodule_t* ISR_CANModule_handle = NULL;
+/* Interrupts the driver runs on. The error interrupt reports failed transmissions, FIFO
+ * overruns and error state changes, not every error frame (no CAN_IT_LAST_ERROR_CODE) */
+#define CO_CAN_NOTIFICATIONS (CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING \
+		| CAN_IT_TX_MAILBOX_EMPTY | CAN_IT_RX_FIFO0_OVERRUN | CAN_IT_RX_FIFO1_OVERRUN \
+		| CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF | CAN_IT_ERROR)
 
+/* All bits of a 16-bit filter, including IDE (only standard frames are used) */
+#define CO_CAN_FILTER16_EXACT 0xFFF8U
+
+static HAL_StatusTypeDef CO_CANfilterBankConfig(CO_CANmodule_t *CANmodule,
+		uint32_t bank, uint32_t mode, uint32_t scale, const uint16_t fr[4],
+		uint32_t activation)
+{
+	CAN_FilterTypeDef filter;
+	filter.FilterActivation = activation;
+	filter.FilterBank = bank;
+	filter.FilterFIFOAssignment = CAN_RX_FIFO0;
+	/* 16-bit scale: FR1 holds filters n and n+1, FR2 holds n+2 and n+3 (list)
+	 * or FR1 is filter n and FR2 is filter n+1 (mask) */
+	filter.FilterIdLow = fr[0];
+	filter.FilterMaskIdLow = fr[1];
+	filter.FilterIdHigh = fr[2];
+	filter.FilterMaskIdHigh = fr[3];
+	filter.FilterMode = mode;
+	filter.FilterScale = scale;
+	filter.SlaveStartFilterBank = CO_CAN_SLAVE_START_FILTER_BANK;
+
+	return HAL_CAN_ConfigFilter((CAN_HandleTypeDef*) CANmodule->CANptr, &filter);
+}
+
+/* rxArray entry a filter dispatches to. Software matching takes the first
+ * entry in rxArray order, so an entry overlapping an earlier one is left to
+ * CO_CANrxFind() instead. */
+static uint16_t CO_CANrxFilterTarget(const CO_CANmodule_t *CANmodule, uint16_t index)
+{
+	const CO_CANrx_t *buffer = &CANmodule->rxArray[index];
+	for (uint16_t k = 0U; k < index; k++)
+	{
+		const CO_CANrx_t *earlier = &CANmodule->rxArray[k];
+		if (((earlier->ident ^ buffer->ident) & earlier->mask & buffer->mask) == 0U)
+		{
+			return CO_CAN_FILTER_NONE;
+		}
+	}
+	return index;
+}
+
+/* Packs the configured rxArray entries into the hardware filter banks and
+ * records which rxArray entry each filter match index belongs to. Exact
+ * identifiers go to 16-bit list banks (4 per bank), masked ones to 16-bit
+ * mask banks (2 per bank). If they do not all fit, the last bank accepts
+ * everything and the remaining entries are matched in software. */
+static CO_ReturnError_t CO_CANrxFiltersApply(CO_CANmodule_t *CANmodule)
+{
+	uint16_t listFr[CO_CAN_FILTER_COUNT], listIndex[CO_CAN_FILTER_COUNT];
+	uint16_t maskFr[CO_CAN_FILTER_COUNT][2], maskIndex[CO_CAN_FILTER_COUNT];
+	uint16_t lists = 0, masks = 0;
+	uint16_t i, n;
+	bool_t skipped = false; /* Entries beyond the local tables */
+
+	if (!CANmodule->useCANrxFilters)
+	{
+		return CO_ERROR_NO;
+	}
+
+	for (i = 0U; i < CANmodule->rxSize; i++)
+	{
+		const CO_CANrx_t *buffer = &CANmodule->rxArray[i];
+		if (buffer->CANrx_callback == NULL)
+		{
+			continue;
+		}
+		const uint16_t id = CO_CANfilter16(buffer->ident);
+		const uint16_t mask = CO_CANfilter16(buffer->mask) | 0x0008U;
+		bool_t duplicate = false;
+
+		if (mask == CO_CAN_FILTER16_EXACT)
+		{
+			for (n = 0U; n < lists && !duplicate; n++)
+			{
+				duplicate = listFr[n] == id;
+			}
+			if (!duplicate && lists < CO_CAN_FILTER_COUNT)
+			{
+				listFr[lists] = id;
+				listIndex[lists++] = i;
+			}
+			else if (!duplicate)
+			{
+				skipped = true;
+			}
+		}
+		else
+		{
+			for (n = 0U; n < masks && !duplicate; n++)
+			{
+				duplicate = maskFr[n][0] == (id & mask) && maskFr[n][1] == mask;
+			}
+			if (!duplicate && masks < CO_CAN_FILTER_COUNT)
+			{
+				maskFr[masks][0] = id & mask;
+				maskFr[masks][1] = mask;
+				maskIndex[masks++] = i;
+			}
+			else if (!duplicate)
+			{
+				skipped = true;
+			}
+		}
+	}
+
+	const uint16_t needed = (uint16_t) ((lists + 3U) / 4U + (masks + 1U) / 2U);
+	const uint16_t usable = (skipped || needed > CANmodule->filterBanks) ?
+			CANmodule->filterBanks - 1U : CANmodule->filterBanks;
+	uint32_t bank = CANmodule->firstFilterBank;
+	const uint32_t lastBank = CANmodule->firstFilterBank + usable;
+	uint16_t fmi = 0U;
+	CO_ReturnError_t ret = CO_ERROR_NO;
+
+	/* Unused filters of a bank repeat its first filter */
+	uint16_t listed = 0U;
+	for (; listed < lists && bank < lastBank; listed += 4U, bank++)
+	{
+		uint16_t fr[4];
+		for (n = 0U; n < 4U; n++)
+		{
+			const uint16_t k = (listed + n < lists) ? listed + n : listed;
+			fr[n] = listFr[k];
+			CANmodule->rxFilterIndex[fmi++] = CO_CANrxFilterTarget(CANmodule, listIndex[k]);
+		}
+		if (CO_CANfilterBankConfig(CANmodule, bank, CAN_FILTERMODE_IDLIST,
+				CAN_FILTERSCALE_16BIT, fr, ENABLE) != HAL_OK)
+		{
+			ret = CO_ERROR_SYSCALL;
+		}
+	}
+	uint16_t masked = 0U;
+	for (; masked < masks && bank < lastBank; masked += 2U, bank++)
+	{
+		const uint16_t k = (masked + 1U < masks) ? masked + 1U : masked;
+		const uint16_t fr[4] =
+		{ maskFr[masked][0], maskFr[masked][1], maskFr[k][0], maskFr[k][1] };
+		CANmodule->rxFilterIndex[fmi++] = CO_CANrxFilterTarget(CANmodule, maskIndex[masked]);
+		CANmodule->rxFilterIndex[fmi++] = CO_CANrxFilterTarget(CANmodule, maskIndex[k]);
+		if (CO_CANfilterBankConfig(CANmodule, bank, CAN_FILTERMODE_IDMASK,
+				CAN_FILTERSCALE_16BIT, fr, ENABLE) != HAL_OK)
+		{
+			ret = CO_ERROR_SYSCALL;
+		}
+	}
+	if (skipped || listed < lists || masked < masks)
+	{
+		/* Out of banks, accept everything else and match it in software. This
+		 * must be a 16-bit mask bank: 32-bit filters and lower filter numbers
+		 * take priority, so the filters above still win for their frames */
+		const uint16_t fr[4] = { 0U, 0U, 0U, 0U };
+		CANmodule->rxFilterIndex[fmi++] = CO_CAN_FILTER_NONE;
+		CANmodule->rxFilterIndex[fmi++] = CO_CAN_FILTER_NONE;
+		if (CO_CANfilterBankConfig(CANmodule, bank++, CAN_FILTERMODE_IDMASK,
+				CAN_FILTERSCALE_16BIT, fr, ENABLE) != HAL_OK)
+		{
+			ret = CO_ERROR_SYSCALL;
+		}
+	}
+	while (fmi < CO_CAN_FILTER_COUNT)
+	{
+		CANmodule->rxFilterIndex[fmi++] = CO_CAN_FILTER_NONE;
+	}
+	/* Switch off banks left over from a previous, larger plan */
+	for (; bank < (uint32_t) CANmodule->firstFilterBank + CANmodule->filterBanks; bank++)
+	{
+		const uint16_t fr[4] = { 0U, 0U, 0U, 0U };
+		if (CO_CANfilterBankConfig(CANmodule, bank, CAN_FILTERMODE_IDMASK,
+				CAN_FILTERSCALE_32BIT, fr, DISABLE) != HAL_OK)
+		{
+			ret = CO_ERROR_SYSCALL;
+		}
+	}
+
+	return ret;
+}
+
+/* Searches rxArray for the entry matching a received identifier */
+static inline CO_CANrx_t* CO_CANrxFind(CO_CANmodule_t *CANmodule, uint32_t rcvMsgIdent)
+{
+	CO_CANrx_t *buffer = &CANmodule->rxArray[0];
+	for (uint16_t index = CANmodule->rxSize; index > 0U; index--)
+	{
+		if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U)
+		{
+			return buffer;
+		}
+		buffer++;
+	}
+	return NULL;
+}
+
+#if CO_CAN_RX_TABLE
+/* Sets table entries of the identifiers an rxArray entry accepts as data
+ * frames, where no earlier entry already claimed them. If replace is given,
+ * entries pointing to it are searched again instead. */
+static void CO_CANrxTableFill(CO_CANmodule_t *CANmodule, uint16_t ident,
+		uint16_t mask, uint16_t index, bool_t replace)
+{
+	if ((ident & mask & 0x02U) != 0U)
+	{
+		return; /* Remote frames only */
+	}
+	const uint16_t id = (ident >> 2) & (mask >> 2) & 0x07FFU;
+	const uint16_t dontCare = ~(mask >> 2) & 0x07FFU;
+	uint16_t bits = 0U;
+
+	/* Walk all combinations of the don't-care bits */
+	do
+	{
+		volatile uint8_t *entry = &CANmodule->rxTable[id | bits];
+		if (replace)
+		{
+			if (*entry == index)
+			{
+				const CO_CANrx_t *buffer = CO_CANrxFind(CANmodule,
+						(uint32_t) (id | bits) << 2);
+				*entry = (buffer != NULL) ?
+						(uint8_t) (buffer - CANmodule->rxArray) : CO_CAN_RX_TABLE_NONE;
+			}
+		}
+		else if (*entry > index)
+		{
+			*entry = (uint8_t) index;
+		}
+		bits = (uint16_t) ((bits - dontCare) & dontCare);
+	} while (bits != 0U);
+}
+#endif
+
+/* Looks up the rxArray entry for a frame the filter match index did not dispatch */
+static inline CO_CANrx_t* CO_CANrxLookup(CO_CANmodule_t *CANmodule, uint32_t rcvMsgIdent)
+{
+#if CO_CAN_RX_TABLE
+	if (CANmodule->useCANrxTable && (rcvMsgIdent & 0x02U) == 0U)
+	{
+		const uint8_t index = CANmodule->rxTable[(rcvMsgIdent >> 2) & 0x07FFU];
+		if (index == CO_CAN_RX_TABLE_NONE)
+		{
+			return NULL;
+		}
+		CO_CANrx_t *buffer = &CANmodule->rxArray[index];
+		if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U)
+		{
+			return buffer;
+		}
+		/* The entry is being reconfigured, fall back to the search */
+	}
+#endif
+	return CO_CANrxFind(CANmodule, rcvMsgIdent);
+}
+
+
+/* Sorts txArray by COB-ID into the pending bitmap order, ties keep their
+ * txArray order. Pending bits are rebuilt from bufferFull. Call with
+ * CO_LOCK_CAN_SEND held. */
+static void CO_CANtxOrder(CO_CANmodule_t *CANmodule)
+{
+	uint16_t i, n;
+
+	for (i = 0U; i < CANmodule->txSize; i++)
+	{
+		const uint16_t cobId = (uint16_t) (CANmodule->txArray[i].ident >> 2);
+		for (n = i; n > 0U
+				&& (CANmodule->txArray[CANmodule->txOrder[n - 1U]].ident >> 2) > cobId; n--)
+		{
+			CANmodule->txOrder[n] = CANmodule->txOrder[n - 1U];
+		}
+		CANmodule->txOrder[n] = (uint8_t) i;
+	}
+	for (i = 0U; i < CO_CAN_TX_PENDING_WORDS; i++)
+	{
+		CANmodule->txPending[i] = 0U;
+	}
+	for (n = 0U; n < CANmodule->txSize; n++)
+	{
+		i = CANmodule->txOrder[n];
+		CANmodule->txBit[i] = (uint8_t) n;
+		if (CANmodule->txArray[i].bufferFull)
+		{
+			CANmodule->txPending[n / 32U] |= 0x80000000UL >> (n % 32U);
+		}
+	}
+}
+
+/* Accounts for the frame CO_CANtxFill() loaded into mailbox i (0..2), which is
+ * free again. Must run before the mailbox is reloaded. Call with
+ * CO_LOCK_CAN_SEND held. */
+static void CO_CANtxDone(CAN_HandleTypeDef *hcan, CO_CANmodule_t *CANmodule, uint8_t i,
+		bool_t transmitted)
+{
+	CO_CANtxMailbox_t *loaded = &CANmodule->txMailbox[i];
+
+	if (!loaded->loaded)
+	{
+		return;
+	}
+	loaded->loaded = false;
+	if (loaded->syncFlag)
+	{
+		CANmodule->txMailboxSync &= (uint8_t) ~(CAN_TX_MAILBOX0 << i);
+	}
+	if (!transmitted)
+	{
+		return;
+	}
+	/* First CAN message (bootup) was sent successfully */
+	CANmodule->firstCANtxMessage = false;
+	CANmodule->stats.txFrames++;
+	CANmodule->stats.txBytes += loaded->DLC;
+	CANmodule->stats.txClass[CO_CANclassOf(loaded->ident >> 2)]++;
+	CANmodule->stats.busBits += CO_CANframeBits(loaded->DLC);
+#if CO_CAN_CAPTURE
+	/* Only the TTCM stamp comes from the registers, not reloaded yet */
+	const uint32_t tdtr = (hcan->Instance->sTxMailBox[i].TDTR & CAN_TDT0R_TIME) | loaded->DLC;
+	CO_CANcaptureFrame((uint16_t) (loaded->ident >> 2),
+			(uint8_t) (CO_CANcaptureChannel(hcan) | CO_CAN_CAPTURE_TX
+					| (((loaded->ident & 0x2U) != 0U) ? CO_CAN_CAPTURE_RTR : 0U)),
+			loaded->DLC, loaded->data,
+			CO_CANtxTime(CANmodule, tdtr, CO_CANcycles()) / (SystemCoreClock / 1000000U));
+#else
+	(void) hcan;
+#endif
+}
+
+/* Moves the lowest pending COB-IDs into the free mailboxes. bxCAN then sends
+ * the mailboxes by identifier (TXFP must stay 0). Call with CO_LOCK_CAN_SEND
+ * held. */
+static void CO_CANtxFill(CO_CANmodule_t *CANmodule)
+{
+	CAN_HandleTypeDef *hcan = (CAN_HandleTypeDef*) CANmodule->CANptr;
+	uint16_t word = 0U;
+
+	if (!CANmodule->CANnormal)
+	{
+		return; /* Sent once CO_CANsetNormalMode() started the module */
+	}
+
+	/* Account for mailboxes that completed before their callback ran, e.g. when
+	 * called from an earlier mailbox callback of the same interrupt. Their
+	 * TXOK bit is still set unless the HAL already saw a failure. */
+	const uint32_t tsr = hcan->Instance->TSR;
+	for (uint8_t i = 0U; i < 3U; i++)
+	{
+		if ((tsr & (CAN_TSR_TME0 << i)) != 0U)
+		{
+			CO_CANtxDone(hcan, CANmodule, i, (tsr & (CAN_TSR_TXOK0 << (8U * i))) != 0U);
+		}
+	}
+
+	while (CANmodule->CANtxCount > 0U && HAL_CAN_GetTxMailboxesFreeLevel(hcan) > 0U)
+	{
+		while (word < CO_CAN_TX_PENDING_WORDS && CANmodule->txPending[word] == 0U)
+		{
+			word++;
+		}
+		if (word == CO_CAN_TX_PENDING_WORDS)
+		{
+			CANmodule->CANtxCount = 0U;
+			break;
+		}
+		const uint32_t bit = __CLZ(CANmodule->txPending[word]);
+		CANmodule->txPending[word] &= ~(0x80000000UL >> bit);
+		CANmodule->CANtxCount--;
+
+		CO_CANtx_t *buffer = &CANmodule->txArray[CANmodule->txOrder[word * 32U + bit]];
+		buffer->bufferFull = false;
+
+		uint32_t TxMailbox;
+		CAN_TxHeaderTypeDef TxHeader;
+
+		TxHeader.ExtId = 0u;
+		TxHeader.IDE = 0;
+		TxHeader.DLC = buffer->DLC;
+		TxHeader.StdId = ( buffer->ident >> 2 );
+		TxHeader.RTR = ( buffer->ident & 0x2 );
+		TxHeader.TransmitGlobalTime = DISABLE;
+		if (HAL_CAN_AddTxMessage(hcan, &TxHeader, &buffer->data[0], &TxMailbox) != HAL_OK)
+		{
+			CANmodule->txErrors++;
+			continue;
+		}
+		const uint8_t i = (TxMailbox == CAN_TX_MAILBOX0) ? 0U :
+				(TxMailbox == CAN_TX_MAILBOX1) ? 1U : 2U;
+		CO_CANtxMailbox_t *loaded = &CANmodule->txMailbox[i];
+		loaded->loaded = true;
+		loaded->syncFlag = buffer->syncFlag;
+		loaded->txIndex = CANmodule->txOrder[word * 32U + bit];
+		loaded->DLC = buffer->DLC;
+		loaded->ident = buffer->ident;
+		memcpy(loaded->data, buffer->data, sizeof(loaded->data));
+		if (buffer->syncFlag)
+		{
+			CANmodule->txMailboxSync |= (uint8_t) TxMailbox;
+		}
+	}
+	CANmodule->bufferInhibitFlag = (CANmodule->txMailboxSync != 0U);
+}
 
 /******************************************************************************DONE*/
 void CO_CANsetConfigurationMode(void *CANptr)
@@ -44,19 +686,25 @@ void CO_CANsetConfigurationMode(void *CANptr)
 void CO_CANsetNormalMode(CO_CANmodule_t *CANmodule)
 {
 	/* Put CAN module in normal mode */
+	/* Program the filters for the receive buffers configured so far */
+	CO_CANrxFiltersApply(CANmodule);
+
 	if (HAL_CAN_Start((CAN_HandleTypeDef*) CANmodule->CANptr) != HAL_OK)
 	{
 		/* Start Error */
 	}
 	if (HAL_CAN_ActivateNotification((CAN_HandleTypeDef*) CANmodule->CANptr,
-	CAN_IT_RX_FIFO0_MSG_PENDING |
-	CAN_IT_RX_FIFO1_MSG_PENDING |
-	CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK)
+			CO_CAN_NOTIFICATIONS) != HAL_OK)
 	{
 		/* Notification Error */
 	}
 
 	CANmodule->CANnormal = true;
+
+	/* Send what was queued before the module was started */
+	CO_LOCK_CAN_SEND(CANmodule);
+	CO_CANtxFill(CANmodule);
+	CO_UNLOCK_CAN_SEND(CANmodule);
 }
 
 /*****************************************************************************DONE*/
@@ -72,8 +720,6 @@ CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t *CANmodule, void *CANptr,
 		return CO_ERROR_ILLEGAL_ARGUMENT;
 	}
 
-	ISR_CANModule_handle = CANmodule;
-
 	/* Configure object variables */
 	CANmodule->CANptr = CANptr;
 	CANmodule->rxArray = rxArray;
@@ -82,11 +728,63 @@ CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t *CANmodule, void *CANptr,
 	CANmodule->txSize = txSize;
 	CANmodule->CANerrorStatus = 0;
 	CANmodule->CANnormal = false;
-	CANmodule->useCANrxFilters = false; //(rxSize <= 32U) ? true : false;/* microcontroller dependent */
 	CANmodule->bufferInhibitFlag = false;
 	CANmodule->firstCANtxMessage = true;
 	CANmodule->CANtxCount = 0U;
 	CANmodule->errOld = 0U;
+	CANmodule->rxErrors = 0U;
+	CANmodule->txErrors = 0U;
+	CANmodule->rxOverflowOld = 0U;
+	CANmodule->lastErrorCode = 0U;
+	CANmodule->busOff = false;
+	CANmodule->busOffCount = 0U;
+	CANmodule->busOffTime = 0U;
+	CANmodule->busOffLeft = 0U;
+	CANmodule->busOffDelay = CO_CAN_BUSOFF_RECOVERY_MS;
+	CANmodule->errorLogCount = 0U;
+	CANmodule->CANbitRate = CANbitRate;
+	memset(&CANmodule->stats, 0, sizeof(CANmodule->stats));
+	CANmodule->loadBits = 0U;
+	CANmodule->loadTime = HAL_GetTick();
+	CANmodule->rxTimeCycles = 0U;
+	CANmodule->rxTimeBits = 0U;
+	CANmodule->rxTimeValid = false;
+	CANmodule->cyclesPerBit = (CANbitRate > 0U) ? SystemCoreClock / (CANbitRate * 1000U) : 0U;
+
+	/* The cycle counter times the interrupts for the statistics */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	/* CAN2 gets the banks after the split, CAN1 the ones before it. Devices
+	 * with a single CAN have no split. */
+	uint32_t firstBank = CO_CAN_FIRST_FILTER_BANK;
+	uint32_t endBank = CO_CAN_FIRST_FILTER_BANK + CO_CAN_FILTER_BANKS;
+#ifdef CAN2
+	if (((CAN_HandleTypeDef*) CANptr)->Instance == CAN2)
+	{
+		firstBank = CO_CAN_SLAVE_START_FILTER_BANK;
+		endBank = CO_CAN_TOTAL_FILTER_BANKS;
+	}
+	else if (endBank > CO_CAN_SLAVE_START_FILTER_BANK)
+	{
+		endBank = CO_CAN_SLAVE_START_FILTER_BANK;
+	}
+#endif
+	if (endBank < firstBank + CO_CAN_FILTER_BANKS)
+	{
+		endBank = (endBank > firstBank) ? endBank : firstBank;
+	}
+	else
+	{
+		endBank = firstBank + CO_CAN_FILTER_BANKS;
+	}
+	CANmodule->firstFilterBank = (uint8_t) firstBank;
+	CANmodule->filterBanks = (uint8_t) (endBank - firstBank);
+	CANmodule->useCANrxFilters = (CANmodule->filterBanks > 0U) ? true : false;
+	for (i = 0U; i < CO_CAN_FILTER_COUNT; i++)
+	{
+		CANmodule->rxFilterIndex[i] = CO_CAN_FILTER_NONE;
+	}
 
 	for (i = 0U; i < rxSize; i++)
 	{
@@ -95,24 +793,74 @@ CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t *CANmodule, void *CANptr,
 		rxArray[i].object = NULL;
 		rxArray[i].CANrx_callback = NULL;
 	}
+#if CO_CAN_RX_TABLE
+	CANmodule->useCANrxTable = (rxSize < CO_CAN_RX_TABLE_NONE) ? true : false;
+	for (i = 0U; i < CO_CAN_RX_TABLE_SIZE; i++)
+	{
+		CANmodule->rxTable[i] = CO_CAN_RX_TABLE_NONE;
+	}
+	if (CANmodule->useCANrxTable)
+	{
+		for (i = 0U; i < rxSize; i++)
+		{
+			CO_CANrxTableFill(CANmodule, rxArray[i].ident, rxArray[i].mask, i, false);
+		}
+	}
+#else
+	CANmodule->useCANrxTable = false;
+#endif
+	if (txSize > CO_CAN_TX_SIZE_MAX)
+	{
+		return CO_ERROR_ILLEGAL_ARGUMENT;
+	}
 	for (i = 0U; i < txSize; i++)
 	{
 		txArray[i].bufferFull = false;
 	}
+	CANmodule->txMailboxSync = 0U;
+	memset(CANmodule->txMailbox, 0, sizeof(CANmodule->txMailbox));
+	CO_CANtxOrder(CANmodule);
+	CANmodule->rxQueueHead = 0U;
+	CANmodule->rxQueueTail = 0U;
+	CANmodule->rxQueueHighWater = 0U;
+	CANmodule->rxQueueOverflows = 0U;
+
+	/* The receive task outlives communication resets, it serves all
+	 * registered modules */
+	if (CO_CANrxTaskHandle == NULL)
+	{
+		static const osThreadAttr_t CO_CANrxTask_attributes =
+		{ .name = "CANopenRx", .stack_size = CO_CAN_RX_TASK_STACK_SIZE,
+				.priority = (osPriority_t) CO_CAN_RX_TASK_PRIORITY, };
+		CO_CANrxTaskHandle = osThreadNew(CO_CANrxTask, NULL, &CO_CANrxTask_attributes);
+		if (CO_CANrxTaskHandle == NULL)
+		{
+			return CO_ERROR_OUT_OF_MEMORY;
+		}
+	}
 
 	/* Configure CAN module registers */
 	CO_CANmodule_disable(CANmodule);
+	if (!CO_CANregister(CANmodule))
+	{
+		return CO_ERROR_OUT_OF_MEMORY;
+	}
 	HAL_CAN_MspDeInit((CAN_HandleTypeDef*) CANmodule->CANptr);
 	HAL_CAN_MspInit((CAN_HandleTypeDef*) CANmodule->CANptr); /* NVIC and GPIO */
 
 	/* Configure CAN timing */
-	MX_CAN1_Init();
-
-	/* Configure CAN module hardware filters */
+	CO_CANhalInit((CAN_HandleTypeDef*) CANptr);
+#if CO_CAN_RX_TIMESTAMP_TTCM
+	/* Still in initialization mode, where MCR is writable */
+	((CAN_HandleTypeDef*) CANptr)->Instance->MCR |= CAN_MCR_TTCM;
+#endif
+
+	/* Accept everything until the receive buffers are configured, the filter
+	 * banks are planned in CO_CANsetNormalMode() */
 	CAN_FilterTypeDef can1_filter_init;
 
 	can1_filter_init.FilterActivation = ENABLE;
-	can1_filter_init.FilterBank  = 0;
+	can1_filter_init.FilterBank  = CANmodule->firstFilterBank;
 	can1_filter_init.FilterFIFOAssignment = CAN_RX_FIFO0;
 	can1_filter_init.FilterIdHigh = 0x0000;
 	can1_filter_init.FilterIdLow = 0x0000;
@@ -120,6 +868,7 @@ CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t *CANmodule, void *CANptr,
 	can1_filter_init.FilterMaskIdLow = 0x0000;
 	can1_filter_init.FilterMode = CAN_FILTERMODE_IDMASK;
 	can1_filter_init.FilterScale = CAN_FILTERSCALE_32BIT;
+	can1_filter_init.SlaveStartFilterBank = CO_CAN_SLAVE_START_FILTER_BANK;
 
 	if( HAL_CAN_ConfigFilter((CAN_HandleTypeDef*) CANmodule->CANptr,&can1_filter_init) != HAL_OK)
 	{
@@ -128,9 +877,7 @@ CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t *CANmodule, void *CANptr,
 
 	/* configure CAN interrupt registers */
 	if (HAL_CAN_ActivateNotification((CAN_HandleTypeDef*) CANmodule->CANptr,
-	CAN_IT_RX_FIFO0_MSG_PENDING |
-	CAN_IT_RX_FIFO1_MSG_PENDING |
-	CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK)
+			CO_CAN_NOTIFICATIONS) != HAL_OK)
 	{
 		/* Notification Error */
 	}
@@ -144,11 +891,10 @@ void CO_CANmodule_disable(CO_CANmodule_t *CANmodule)
 	if (CANmodule != NULL)
 	{
 		/* turn off the module */
-		HAL_CAN_DeactivateNotification((CAN_HandleTypeDef*) CANmodule->CANptr ,
-				CAN_IT_RX_FIFO0_MSG_PENDING |
-				CAN_IT_RX_FIFO1_MSG_PENDING |
-				CAN_IT_TX_MAILBOX_EMPTY);
+		HAL_CAN_DeactivateNotification((CAN_HandleTypeDef*) CANmodule->CANptr,
+				CO_CAN_NOTIFICATIONS);
 		HAL_CAN_Stop((CAN_HandleTypeDef*) CANmodule->CANptr);
+		CO_CANunregister(CANmodule);
 	}
 }
 
@@ -164,6 +910,8 @@ CO_ReturnError_t CO_CANrxBufferInit(CO_CANmodule_t *CANmodule, uint16_t index,
 	{
 		/* buffer, which will be configured */
 		CO_CANrx_t *buffer = &CANmodule->rxArray[index];
+		const uint16_t oldIdent = buffer->ident;
+		const uint16_t oldMask = buffer->mask;
 
 		/* Configure object variables */
 		buffer->object = object;
@@ -180,20 +928,24 @@ CO_ReturnError_t CO_CANrxBufferInit(CO_CANmodule_t *CANmodule, uint16_t index,
 		buffer->mask = (mask & 0x07FFU) << 2;
 		buffer->mask |= 0x02;
 
-		CAN_FilterTypeDef can1_filter_init;
-		can1_filter_init.FilterActivation = ENABLE;
-		can1_filter_init.FilterBank  = 0;
-		can1_filter_init.FilterFIFOAssignment = CAN_RX_FIFO0;
-		can1_filter_init.FilterIdHigh = 0x0000;
-		can1_filter_init.FilterIdLow = 0x0000;
-		can1_filter_init.FilterMaskIdHigh = 0x0000;
-		can1_filter_init.FilterMaskIdLow = 0x0000;
-		can1_filter_init.FilterMode = CAN_FILTERMODE_IDMASK;
-		can1_filter_init.FilterScale = CAN_FILTERSCALE_32BIT;
-
-		if( HAL_CAN_ConfigFilter((CAN_HandleTypeDef*) CANmodule->CANptr,&can1_filter_init) != HAL_OK)
+#if CO_CAN_RX_TABLE
+		/* Hand the identifiers the entry gave up to the next matching entry,
+		 * then claim the new ones */
+		if (CANmodule->useCANrxTable)
 		{
-			ret = CO_ERROR_SYSCALL;
+			CO_CANrxTableFill(CANmodule, oldIdent, oldMask, index, true);
+			CO_CANrxTableFill(CANmodule, buffer->ident, buffer->mask, index, false);
+		}
+#else
+		(void) oldIdent;
+		(void) oldMask;
+#endif
+
+		/* Buffers changed at run time (e.g. PDO COB-ID) take effect right away,
+		 * during initialization the banks are planned once in CO_CANsetNormalMode() */
+		if (CANmodule->CANnormal)
+		{
+			ret = CO_CANrxFiltersApply(CANmodule);
 		}
 	}
 	else
@@ -220,12 +972,26 @@ CO_CANtx_t* CO_CANtxBufferInit(CO_CANmodule_t *CANmodule, uint16_t index,
 //		buffer->ident = ((uint32_t) ident & 0x07FFU)
 //				| ((uint32_t) (((uint32_t) noOfBytes & 0xFU) << 12U))
 //				| ((uint32_t) (rtr ? 0x8000U : 0U));
+		CO_LOCK_CAN_SEND(CANmodule);
+		const uint32_t oldIdent = buffer->ident;
 		buffer->ident = (ident & 0x7ff) << 2;
 		if (rtr) buffer->ident |= 0x02;
 
 		buffer->DLC = noOfBytes;
-		buffer->bufferFull = false;
+		if (buffer->bufferFull)
+		{
+			buffer->bufferFull = false;
+			CANmodule->txPending[CANmodule->txBit[index] / 32U] &=
+					~(0x80000000UL >> (CANmodule->txBit[index] % 32U));
+			CANmodule->CANtxCount--;
+		}
 		buffer->syncFlag = syncFlag;
+		/* A new COB-ID moves the buffer in the priority order */
+		if ((oldIdent >> 2) != (buffer->ident >> 2))
+		{
+			CO_CANtxOrder(CANmodule);
+		}
+		CO_UNLOCK_CAN_SEND(CANmodule);
 	}
 
 	return buffer;
@@ -248,34 +1014,21 @@ CO_ReturnError_t CO_CANsend(CO_CANmodule_t *CANmodule, CO_CANtx_t *buffer)
 	}
 
 	CO_LOCK_CAN_SEND(CANmodule);
-
-	uint32_t TxMailboxNum;
-	CAN_TxHeaderTypeDef TxHeader;
-
-	TxHeader.ExtId = 0u;
-	TxHeader.IDE = 0;
-	TxHeader.DLC = buffer->DLC;
-	TxHeader.StdId = ( buffer->ident >> 2 );
-	TxHeader.RTR = ( buffer->ident & 0x2 );
-
-
-	/* if CAN TX buffer is free, copy message to it */
-	if ((HAL_CAN_GetTxMailboxesFreeLevel((CAN_HandleTypeDef*) CANmodule->CANptr) > 0 )
-			&& CANmodule->CANtxCount == 0)
-	{
-		CANmodule->bufferInhibitFlag = buffer->syncFlag;
-		/* copy message and txRequest */
-		if(HAL_CAN_AddTxMessage((CAN_HandleTypeDef*) CANmodule->CANptr, &TxHeader, &buffer->data[0], &TxMailboxNum) != HAL_OK)
-		{
-			err = CO_ERROR_SYSCALL;
-		}
-	}
-	/* if no buffer is free, message will be sent by interrupt */
-	else
+	/* Queue the frame by COB-ID, it goes out right away if a mailbox is
+	 * free and no lower COB-ID is waiting. A frame already queued is only
+	 * updated. */
+	if (!buffer->bufferFull)
 	{
+		const uint8_t bit = CANmodule->txBit[buffer - CANmodule->txArray];
 		buffer->bufferFull = true;
+		CANmodule->txPending[bit / 32U] |= 0x80000000UL >> (bit % 32U);
 		CANmodule->CANtxCount++;
 	}
+	CO_CANtxFill(CANmodule);
+	if (buffer->bufferFull)
+	{
+		CANmodule->stats.mailboxFull++;
+	}
 	CO_UNLOCK_CAN_SEND(CANmodule);
 
 	return err;
@@ -289,12 +1042,11 @@ void CO_CANclearPendingSyncPDOs(CO_CANmodule_t *CANmodule)
 	CO_LOCK_CAN_SEND(CANmodule);
 	/* Abort message from CAN module, if there is synchronous TPDO.
 	 * Take special care with this functionality. */
-	auto pendingMsgs = 3 - HAL_CAN_GetTxMailboxesFreeLevel((CAN_HandleTypeDef*) CANmodule->CANptr);
-	if ( (pendingMsgs > 0) && CANmodule->bufferInhibitFlag)
+	if (CANmodule->txMailboxSync != 0U)
 	{
-		// TODO: Come back to this later, does it clear all queued messages or only the TPDOs?
-		//		HAL_CAN_AbortTxRequest((CAN_HandleTypeDef*) CANmodule->CANptr, (CAN_TX_MAILBOX0 | CAN_TX_MAILBOX1 | CAN_TX_MAILBOX2));
-		/* clear TXREQ */
+		/* clear TXREQ of the mailboxes holding them, the abort callbacks refill the mailboxes */
+		HAL_CAN_AbortTxRequest((CAN_HandleTypeDef*) CANmodule->CANptr, CANmodule->txMailboxSync);
+		CANmodule->txMailboxSync = 0U;
 		CANmodule->bufferInhibitFlag = false;
 		tpdoDeleted = 1U;
 	}
@@ -309,7 +1061,9 @@ void CO_CANclearPendingSyncPDOs(CO_CANmodule_t *CANmodule)
 			{
 				if (buffer->syncFlag)
 				{
+					const uint8_t bit = CANmodule->txBit[buffer - CANmodule->txArray];
 					buffer->bufferFull = false;
+					CANmodule->txPending[bit / 32U] &= ~(0x80000000UL >> (bit % 32U));
 					CANmodule->CANtxCount--;
 					tpdoDeleted = 2U;
 				}
@@ -327,13 +1081,98 @@ void CO_CANclearPendingSyncPDOs(CO_CANmodule_t *CANmodule)
 /*****************************************************************************DONE?*/
 /* Get error counters from the module. If necessary, function may use
  * different way to determine errors. */
-static uint16_t rxErrors = 0, txErrors = 0, overflow = 0;
+
+/* Appends an error state change to the error log, overwriting the oldest */
+static void CO_CANerrorRecord(CO_CANmodule_t *CANmodule, uint32_t esr, bool_t recovery)
+{
+	CO_CANerrorEvent_t *event =
+			&CANmodule->errorLog[CANmodule->errorLogCount % CO_CAN_ERROR_LOG_SIZE];
+	event->timestamp = HAL_GetTick();
+	event->status = CANmodule->CANerrorStatus;
+	event->tec = (uint8_t) ((esr & CAN_ESR_TEC_Msk) >> CAN_ESR_TEC_Pos);
+	event->rec = (uint8_t) ((esr & CAN_ESR_REC_Msk) >> CAN_ESR_REC_Pos);
+	event->lec = CANmodule->lastErrorCode;
+	event->recovery = recovery;
+	CANmodule->errorLogCount++;
+}
+
+/* Restarts the module out of bus-off after the recovery delay. Without ABOM
+ * bxCAN only leaves bus-off when software cycles it through initialization
+ * mode, it then waits for 128 x 11 recessive bits before joining the bus. */
+static void CO_CANbusOffRecovery(CO_CANmodule_t *CANmodule, uint32_t esr)
+{
+	CAN_HandleTypeDef *hcan = (CAN_HandleTypeDef*) CANmodule->CANptr;
+	const uint32_t now = HAL_GetTick();
+
+	if ((esr & CAN_ESR_BOFF) == 0U)
+	{
+		if (CANmodule->busOff)
+		{
+			CANmodule->busOff = false;
+			CANmodule->busOffLeft = now;
+		}
+		return;
+	}
+	if ((hcan->Instance->MCR & CAN_MCR_ABOM) != 0U)
+	{
+		return; /* The hardware recovers by itself */
+	}
+
+	if (!CANmodule->busOff)
+	{
+		/* Back off while the node keeps going bus-off soon after recovering */
+		CANmodule->busOff = true;
+		CANmodule->busOffTime = now;
+		if (CANmodule->busOffCount > 0U
+				&& now - CANmodule->busOffLeft < CO_CAN_BUSOFF_RECOVERY_MAX_MS)
+		{
+			CANmodule->busOffDelay = (CANmodule->busOffDelay * 2U < CO_CAN_BUSOFF_RECOVERY_MAX_MS) ?
+					CANmodule->busOffDelay * 2U : CO_CAN_BUSOFF_RECOVERY_MAX_MS;
+		}
+		else
+		{
+			CANmodule->busOffDelay = CO_CAN_BUSOFF_RECOVERY_MS;
+		}
+		CANmodule->busOffCount++;
+	}
+	else if (now - CANmodule->busOffTime >= CANmodule->busOffDelay)
+	{
+		CANmodule->busOffTime = now;
+		HAL_CAN_Stop(hcan);
+		HAL_CAN_Start(hcan);
+		CO_CANerrorRecord(CANmodule, esr, true);
+
+		/* Queued frames go out once the module is back on the bus */
+		CO_LOCK_CAN_SEND(CANmodule);
+		CO_CANtxFill(CANmodule);
+		CO_UNLOCK_CAN_SEND(CANmodule);
+	}
+}
 
 void CO_CANmodule_process(CO_CANmodule_t *CANmodule)
 {
+	CAN_TypeDef *can = ((CAN_HandleTypeDef*) CANmodule->CANptr)->Instance;
+	const uint32_t esr = can->ESR;
+	const uint32_t tec = (esr & CAN_ESR_TEC_Msk) >> CAN_ESR_TEC_Pos;
+	const uint32_t rec = (esr & CAN_ESR_REC_Msk) >> CAN_ESR_REC_Pos;
+	const uint8_t lec = (uint8_t) ((esr & CAN_ESR_LEC_Msk) >> CAN_ESR_LEC_Pos);
 	uint32_t err;
 
-	err = ((uint32_t) txErrors << 16) | ((uint32_t) rxErrors << 8) | overflow;
+	/* LEC holds the last error until overwritten, setting it to the unused
+	 * code 7 shows when the next one happens. The other ESR bits are read-only. */
+	if (lec != 0U && lec != 7U)
+	{
+		CANmodule->lastErrorCode = lec;
+		can->ESR = CAN_ESR_LEC_Msk;
+	}
+
+	/* Overflow is reported while frames were lost since the last call */
+	const uint32_t rxOverflow = CANmodule->stats.rxOverflow;
+	const bool_t overflow = (rxOverflow != CANmodule->rxOverflowOld);
+	CANmodule->rxOverflowOld = rxOverflow;
+
+	err = (esr & (CAN_ESR_TEC_Msk | CAN_ESR_REC_Msk | CAN_ESR_BOFF))
+			| (overflow ? (1UL << 8) : 0U);
 
 	if (CANmodule->errOld != err)
 	{
@@ -341,7 +1180,7 @@ void CO_CANmodule_process(CO_CANmodule_t *CANmodule)
 
 		CANmodule->errOld = err;
 
-		if (txErrors >= 256U)
+		if ((esr & CAN_ESR_BOFF) != 0U)
 		{
 			/* bus off */
 			status |= CO_CAN_ERRTX_BUS_OFF;
@@ -355,21 +1194,21 @@ void CO_CANmodule_process(CO_CANmodule_t *CANmodule)
 							| CO_CAN_ERRTX_PASSIVE);
 
 			/* rx bus warning or passive */
-			if (rxErrors >= 128)
+			if (rec >= 128)
 			{
 				status |= CO_CAN_ERRRX_WARNING | CO_CAN_ERRRX_PASSIVE;
 			}
-			else if (rxErrors >= 96)
+			else if (rec >= 96)
 			{
 				status |= CO_CAN_ERRRX_WARNING;
 			}
 
 			/* tx bus warning or passive */
-			if (txErrors >= 128)
+			if (tec >= 128)
 			{
 				status |= CO_CAN_ERRTX_WARNING | CO_CAN_ERRTX_PASSIVE;
 			}
-			else if (rxErrors >= 96)
+			else if (tec >= 96)
 			{
 				status |= CO_CAN_ERRTX_WARNING;
 			}
@@ -381,192 +1220,404 @@ void CO_CANmodule_process(CO_CANmodule_t *CANmodule)
 			}
 		}
 
-		if (overflow != 0)
+		if (overflow)
 		{
 			/* CAN RX bus overflow */
 			status |= CO_CAN_ERRRX_OVERFLOW;
 		}
+		else
+		{
+			status &= 0xFFFF ^ CO_CAN_ERRRX_OVERFLOW;
+		}
 
-		CANmodule->CANerrorStatus = status;
+		if (status != CANmodule->CANerrorStatus)
+		{
+			CANmodule->CANerrorStatus = status;
+			CO_CANerrorRecord(CANmodule, esr, false);
+		}
 	}
-}
 
-/******************************************************************************/
+	CO_CANbusOffRecovery(CANmodule, esr);
 
+	/* Keep the 64-bit timebase extended */
+	(void) CO_CANcycles();
 
-// DONE???
-void CO_CAN_RXISR(CAN_HandleTypeDef *hcan, CO_CANmodule_t *CANmodule, uint8_t fifo)
+	/* Bus load over the last window: bits seen / bits the bit rate allows */
+	const uint32_t now = HAL_GetTick();
+	const uint32_t window = now - CANmodule->loadTime;
+	if (window >= CO_CAN_LOAD_WINDOW_MS && CANmodule->CANbitRate > 0U)
+	{
+		const uint32_t bits = CANmodule->stats.busBits - CANmodule->loadBits;
+		const uint64_t load = (uint64_t) bits * 10000U
+				/ ((uint64_t) CANmodule->CANbitRate * window);
+		CANmodule->stats.busLoad = (uint16_t) (load > 10000U ? 10000U : load);
+		CANmodule->loadBits += bits;
+		CANmodule->loadTime = now;
+	}
+}
+
+void CO_CANgetStats(CO_CANmodule_t *CANmodule, CO_CANstats_t *stats)
 {
-	static CO_CANrxMsg_t rcvMsg; /* pointer to received message in CAN module */
-	uint16_t index; /* index of received message */
-	uint32_t rcvMsgIdent; /* identifier of the received message */
-	CO_CANrx_t *buffer; /* receive message buffer from CO_CANmodule_t object. */
-	bool_t msgMatched = false;
+	CO_LOCK_CAN_SEND(CANmodule);
+	*stats = CANmodule->stats;
+	CO_UNLOCK_CAN_SEND(CANmodule);
+}
 
-//	rcvMsg = 0; /* get message from module here */
-	uint32_t fifonum;
-	if(fifo == 0)
+void CO_CANresetStats(CO_CANmodule_t *CANmodule)
+{
+	CO_LOCK_CAN_SEND(CANmodule);
+	const uint16_t busLoad = CANmodule->stats.busLoad;
+	memset(&CANmodule->stats, 0, sizeof(CANmodule->stats));
+	CANmodule->stats.busLoad = busLoad;
+	CANmodule->loadBits = 0U;
+	CANmodule->rxOverflowOld = 0U;
+	CO_UNLOCK_CAN_SEND(CANmodule);
+}
+
+static ODR_t CO_CANstatsReadOD(OD_stream_t *stream, void *buf, OD_size_t count,
+		OD_size_t *countRead)
+{
+	if (stream == NULL || buf == NULL || countRead == NULL)
 	{
-		fifonum = CAN_RX_FIFO0;
+		return ODR_DEV_INCOMPAT;
 	}
-	else if(fifo == 1)
+	if (stream->subIndex == 0U)
 	{
-		fifonum = CAN_RX_FIFO1;
+		return OD_readOriginal(stream, buf, count, countRead);
 	}
-	else
+	if (count < sizeof(uint32_t))
 	{
-		rxErrors++;
-		return; // Invalid parameter
+		return ODR_DEV_INCOMPAT;
 	}
 
-	auto res = HAL_CAN_GetRxMessage((CAN_HandleTypeDef*) CANmodule->CANptr, fifonum, &rcvMsg.RxHeader, &rcvMsg.data[0]);
-	if(res != HAL_OK)
+	CO_CANstats_t stats;
+	uint32_t value;
+	CO_CANgetStats((CO_CANmodule_t*) stream->object, &stats);
+
+	switch (stream->subIndex)
 	{
-		rxErrors++;
-		return; // Error
+	case CO_CAN_STATS_OD_RX_FRAMES:		value = stats.rxFrames;		break;
+	case CO_CAN_STATS_OD_TX_FRAMES:		value = stats.txFrames;		break;
+	case CO_CAN_STATS_OD_RX_BYTES:		value = stats.rxBytes;		break;
+	case CO_CAN_STATS_OD_TX_BYTES:		value = stats.txBytes;		break;
+	case CO_CAN_STATS_OD_MAILBOX_FULL:	value = stats.mailboxFull;	break;
+	case CO_CAN_STATS_OD_BUS_LOAD:		value = stats.busLoad;		break;
+	case CO_CAN_STATS_OD_RX_OVERFLOWS:
+		value = ((CO_CANmodule_t*) stream->object)->rxQueueOverflows;
+		break;
+	case CO_CAN_STATS_OD_RX_ISR_MAX:	value = stats.rxIsrMax;		break;
+	case CO_CAN_STATS_OD_TX_ISR_MAX:	value = stats.txIsrMax;		break;
+	default:
+		if (stream->subIndex < CO_CAN_STATS_OD_TX_CLASS)
+		{
+			value = stats.rxClass[stream->subIndex - CO_CAN_STATS_OD_RX_CLASS];
+		}
+		else if (stream->subIndex < CO_CAN_STATS_OD_COUNT)
+		{
+			value = stats.txClass[stream->subIndex - CO_CAN_STATS_OD_TX_CLASS];
+		}
+		else
+		{
+			return ODR_SUB_NOT_EXIST;
+		}
+		break;
 	}
 
-	rcvMsgIdent = (rcvMsg.RxHeader.StdId << 2) | (rcvMsg.RxHeader.RTR << 1);
+	CO_setUint32(buf, value);
+	*countRead = sizeof(uint32_t);
+	return ODR_OK;
+}
 
+CO_ReturnError_t CO_CANstatsInitOD(CO_CANmodule_t *CANmodule, OD_entry_t *entry,
+		OD_extension_t *extension)
+{
+	if (CANmodule == NULL || entry == NULL || extension == NULL)
+	{
+		return CO_ERROR_ILLEGAL_ARGUMENT;
+	}
+	extension->object = CANmodule;
+	extension->read = CO_CANstatsReadOD;
+	extension->write = NULL;
+	return (OD_extension_init(entry, extension) == ODR_OK) ?
+			CO_ERROR_NO : CO_ERROR_OD_PARAMETERS;
+}
 
-	if (CANmodule->useCANrxFilters)
+uint16_t CO_CANerrorLog(const CO_CANmodule_t *CANmodule, CO_CANerrorEvent_t events[], uint16_t count)
+{
+	const uint16_t recorded = CANmodule->errorLogCount;
+	const uint16_t available = (recorded < CO_CAN_ERROR_LOG_SIZE) ? recorded : CO_CAN_ERROR_LOG_SIZE;
+	if (count > available)
 	{
-		/* CAN module filters are used. Message with known 11-bit identifier has */
-		/* been received */
-		// TODO: Unsupported for now
-//		index = 0; /* get index of the received message here. Or something similar */
-//		if (index < CANmodule->rxSize)
-//		{
-//			buffer = &CANmodule->rxArray[index];
-//			/* verify also RTR */
-//			if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U)
-//			{
-//				msgMatched = true;
-//			}
-//		}
+		count = available;
 	}
-	else
+	for (uint16_t i = 0U; i < count; i++)
 	{
-		/* CAN module filters are not used, message with any standard 11-bit identifier */
-		/* has been received. Search rxArray form CANmodule for the same CAN-ID. */
-		buffer = &CANmodule->rxArray[0];
-		for (index = CANmodule->rxSize; index > 0U; index--)
+		events[i] = CANmodule->errorLog[(uint16_t) (recorded - count + i) % CO_CAN_ERROR_LOG_SIZE];
+	}
+	return count;
+}
+
+/******************************************************************************/
+
+
+/* Bottom half: finds the rxArray entry for a queued frame and runs its callback */
+static void CO_CANrxDispatch(CO_CANmodule_t *CANmodule, CO_CANrxMsg_t *rcvMsg)
+{
+	uint16_t index; /* index of received message */
+	uint32_t rcvMsgIdent; /* identifier of the received message */
+	CO_CANrx_t *buffer = NULL; /* receive message buffer from CO_CANmodule_t object. */
+	bool_t msgMatched = false;
+
+	rcvMsgIdent = (rcvMsg->RxHeader.StdId << 2) | (rcvMsg->RxHeader.RTR << 1);
+
+	if (CANmodule->useCANrxFilters)
+	{
+		/* CAN module filters are used. The filter match index tells which
+		 * rxArray entry the frame is for */
+		const uint32_t fmi = rcvMsg->RxHeader.FilterMatchIndex;
+		index = (fmi < CO_CAN_FILTER_COUNT) ?
+				CANmodule->rxFilterIndex[fmi] : CO_CAN_FILTER_NONE;
+		if (index < CANmodule->rxSize)
 		{
+			buffer = &CANmodule->rxArray[index];
+			/* verify also RTR, and that the filters weren't reprogrammed meanwhile */
 			if (((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U)
 			{
 				msgMatched = true;
-				break;
 			}
-			buffer++;
 		}
 	}
+	if (!msgMatched)
+	{
+		/* CAN module filters are not used, or the accept-all bank let the frame
+		 * through. Look up the rxArray entry for the same CAN-ID. */
+		buffer = CO_CANrxLookup(CANmodule, rcvMsgIdent);
+		msgMatched = (buffer != NULL);
+	}
 
 	/* Call specific function, which will process the message */
 	if (msgMatched && (buffer != NULL) && (buffer->CANrx_callback != NULL))
 	{
-		buffer->CANrx_callback(buffer->object, (void*) &rcvMsg);
+		buffer->CANrx_callback(buffer->object, (void*) rcvMsg);
 	}
-
-	/* Clear interrupt flag */
 }
 
-// DONE??
-void CO_CAN_TXISR(CAN_HandleTypeDef *hcan, CO_CANmodule_t *CANmodule)
+/* Processes the queued frames in order, the queue slot is released after its callback */
+static void CO_CANrxProcess(CO_CANmodule_t *CANmodule)
 {
-	/* Clear interrupt flag */
-
-	/* First CAN message (bootup) was sent successfully */
-	CANmodule->firstCANtxMessage = false;
-	/* clear flag from previous message */
-	CANmodule->bufferInhibitFlag = false;
-	/* Are there any new messages waiting to be send */
-	if (CANmodule->CANtxCount > 0U)
+	uint16_t tail = CANmodule->rxQueueTail;
+	while (tail != CANmodule->rxQueueHead)
 	{
-		uint16_t i; /* index of transmitting message */
+		__DMB();
+		CO_CANrxMsg_t *rcvMsg = &CANmodule->rxQueue[tail & (CO_CAN_RX_QUEUE_SIZE - 1U)];
+		/* The interrupt left the start of frame in CPU cycles */
+		rcvMsg->timestamp_us /= SystemCoreClock / 1000000U;
+		CO_CANrxDispatch(CANmodule, rcvMsg);
+		tail++;
+		__DMB();
+		CANmodule->rxQueueTail = tail;
+	}
+}
 
-		/* first buffer */
-		CO_CANtx_t *buffer = &CANmodule->txArray[0];
-		/* search through whole array of pointers to transmit message buffers. */
-		for (i = CANmodule->txSize; i > 0U; i--)
+static void CO_CANrxTask(void *argument)
+{
+	(void) argument;
+	for (;;)
+	{
+		osThreadFlagsWait(CO_CAN_RX_FLAG, osFlagsWaitAny, osWaitForever);
+		for (uint8_t i = 0U; i < CO_CAN_MODULES_MAX; i++)
 		{
-			/* if message buffer is full, send it. */
-			if (buffer->bufferFull)
+			CO_CANmodule_t *CANmodule = CO_CANmodules[i];
+			if (CANmodule != NULL)
 			{
-				buffer->bufferFull = false;
-				CANmodule->CANtxCount--;
-
-				/* Copy message to CAN buffer */
-				CANmodule->bufferInhibitFlag = buffer->syncFlag;
-
-				/* canSend... */
-				uint32_t TxMailbox;
-				CAN_TxHeaderTypeDef TxHeader;
-
-				TxHeader.ExtId = 0u;
-				TxHeader.IDE = 0;
-				TxHeader.DLC = buffer->DLC;
-				TxHeader.StdId = ( buffer->ident >> 2 );
-				TxHeader.RTR = ( buffer->ident & 0x2 );
-				if(HAL_CAN_AddTxMessage((CAN_HandleTypeDef*) CANmodule->CANptr, &TxHeader, &buffer->data[0], &TxMailbox) != HAL_OK)
-				{
-					txErrors++;
-				}
-
-				break; /* exit for loop */
+				CO_CANrxProcess(CANmodule);
 			}
-			buffer++;
-		}/* end of for loop */
+		}
+	}
+}
 
-		/* Clear counter if no more messages */
-		if (i == 0U)
+/* Moves all pending frames of one FIFO into rxQueue, returns the number moved */
+static uint16_t CO_CANrxDrain(CAN_HandleTypeDef *hcan, CO_CANmodule_t *CANmodule, uint32_t fifonum)
+{
+	uint16_t moved = 0U;
+	while (HAL_CAN_GetRxFifoFillLevel(hcan, fifonum) > 0U)
+	{
+		const uint16_t head = CANmodule->rxQueueHead;
+		const uint16_t used = (uint16_t) (head - CANmodule->rxQueueTail);
+		CO_CANrxMsg_t *rcvMsg;
+		CO_CANrxMsg_t dropped;
+
+		/* A full queue still empties the FIFO, so the newest frames are lost
+		 * instead of the FIFO overrunning and stalling reception */
+		rcvMsg = (used < CO_CAN_RX_QUEUE_SIZE) ?
+				&CANmodule->rxQueue[head & (CO_CAN_RX_QUEUE_SIZE - 1U)] : &dropped;
+		if (HAL_CAN_GetRxMessage(hcan, fifonum, &rcvMsg->RxHeader, &rcvMsg->data[0]) != HAL_OK)
 		{
-			CANmodule->CANtxCount = 0U;
+			CANmodule->rxErrors++;
+			break;
+		}
+		if (rcvMsg == &dropped)
+		{
+			CANmodule->rxQueueOverflows++;
+			CANmodule->stats.rxOverflow++;
+			continue;
+		}
+		/* Converted to microseconds by CO_CANrxProcess() */
+		rcvMsg->timestamp_us = CO_CANrxTime(CANmodule, rcvMsg, CO_CANcycles());
+		CANmodule->stats.rxFrames++;
+		CANmodule->stats.rxBytes += rcvMsg->RxHeader.DLC;
+		CANmodule->stats.rxClass[CO_CANclassOf(rcvMsg->RxHeader.StdId)]++;
+		CANmodule->stats.busBits += CO_CANframeBits(rcvMsg->RxHeader.DLC);
+#if CO_CAN_CAPTURE
+		CO_CANcaptureFrame((uint16_t) rcvMsg->RxHeader.StdId,
+				(uint8_t) (CO_CANcaptureChannel(hcan)
+						| ((rcvMsg->RxHeader.RTR == CAN_RTR_REMOTE) ? CO_CAN_CAPTURE_RTR : 0U)),
+				(uint8_t) rcvMsg->RxHeader.DLC, rcvMsg->data,
+				rcvMsg->timestamp_us / (SystemCoreClock / 1000000U));
+#endif
+		if (used + 1U > CANmodule->rxQueueHighWater)
+		{
+			CANmodule->rxQueueHighWater = used + 1U;
 		}
+		__DMB();
+		CANmodule->rxQueueHead = head + 1U;
+		moved++;
+	}
+	return moved;
+}
+
+/* Top half: empties both FIFOs, the callbacks run later in CO_CANrxTask */
+void CO_CAN_RXISR(CAN_HandleTypeDef *hcan, CO_CANmodule_t *CANmodule, uint8_t fifo)
+{
+	const uint32_t start = DWT->CYCCNT;
+	uint16_t moved;
+
+	/* Both FIFO interrupts produce into the same queue, CO_CANirqPriority()
+	 * keeps them from preempting each other */
+	if (fifo == 1U)
+	{
+		moved = CO_CANrxDrain(hcan, CANmodule, CAN_RX_FIFO1);
+		moved += CO_CANrxDrain(hcan, CANmodule, CAN_RX_FIFO0);
+	}
+	else
+	{
+		moved = CO_CANrxDrain(hcan, CANmodule, CAN_RX_FIFO0);
+		moved += CO_CANrxDrain(hcan, CANmodule, CAN_RX_FIFO1);
+	}
+	CO_CANisrCycles(CANmodule->stats.rxIsrCycles, &CANmodule->stats.rxIsrMax,
+			DWT->CYCCNT - start);
+
+	if (moved > 0U && CO_CANrxTaskHandle != NULL)
+	{
+		osThreadFlagsSet(CO_CANrxTaskHandle, CO_CAN_RX_FLAG);
+	}
+}
+
+// DONE??
+/* A mailbox became free, mailbox is its CAN_TX_MAILBOXx bit. transmitted is
+ * false if its frame was aborted or failed. */
+void CO_CAN_TXISR(CAN_HandleTypeDef *hcan, CO_CANmodule_t *CANmodule, uint32_t mailbox,
+		bool_t transmitted)
+{
+	const uint32_t start = DWT->CYCCNT;
+	const uint8_t i = (mailbox == CAN_TX_MAILBOX0) ? 0U : (mailbox == CAN_TX_MAILBOX1) ? 1U : 2U;
+
+	CO_LOCK_CAN_SEND(CANmodule);
+	/* The HAL clears RQCP before the callback. If the mailbox was reloaded
+	 * since (busy), or completed again (RQCP set, its own callback follows),
+	 * the frame this callback is about was accounted for by CO_CANtxFill(). */
+	const uint32_t tsr = hcan->Instance->TSR;
+	if ((tsr & (CAN_TSR_TME0 << i)) != 0U && (tsr & (CAN_TSR_RQCP0 << (8U * i))) == 0U)
+	{
+		CO_CANtxDone(hcan, CANmodule, i, transmitted);
 	}
+	/* Refill with the lowest pending COB-IDs */
+	CO_CANtxFill(CANmodule);
+	CO_CANisrCycles(CANmodule->stats.txIsrCycles, &CANmodule->stats.txIsrMax,
+			DWT->CYCCNT - start);
+	CO_UNLOCK_CAN_SEND(CANmodule);
 }
 
 // DONE
 void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan)
 {
-	if(ISR_CANModule_handle != nullptr) CO_CAN_TXISR(hcan, ISR_CANModule_handle);
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_TXISR(hcan, CANmodule, CAN_TX_MAILBOX0, true);
 }
 // DONE
 void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan)
 {
-	if(ISR_CANModule_handle != nullptr) CO_CAN_TXISR(hcan, ISR_CANModule_handle);
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_TXISR(hcan, CANmodule, CAN_TX_MAILBOX1, true);
 }
 // DONE
 void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan)
 {
-	if(ISR_CANModule_handle != nullptr) CO_CAN_TXISR(hcan, ISR_CANModule_handle);
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_TXISR(hcan, CANmodule, CAN_TX_MAILBOX2, true);
+}
+
+void HAL_CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef *hcan)
+{
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_TXISR(hcan, CANmodule, CAN_TX_MAILBOX0, false);
+}
+
+void HAL_CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef *hcan)
+{
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_TXISR(hcan, CANmodule, CAN_TX_MAILBOX1, false);
+}
+
+void HAL_CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef *hcan)
+{
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_TXISR(hcan, CANmodule, CAN_TX_MAILBOX2, false);
 }
 // DONE
 void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 {
-	if(ISR_CANModule_handle != nullptr) CO_CAN_RXISR(hcan, ISR_CANModule_handle, 0);
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_RXISR(hcan, CANmodule, 0);
 }
 // DONE
 void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan)
 {
-	if(ISR_CANModule_handle != nullptr) CO_CAN_RXISR(hcan, ISR_CANModule_handle, 1);
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule != nullptr) CO_CAN_RXISR(hcan, CANmodule, 1);
 }
 // DONE
 void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan)
 {
-	auto err = HAL_CAN_GetError(hcan);
-	switch(err)
+	CO_CANmodule_t *CANmodule = CO_CANmoduleOf(hcan);
+	if(CANmodule == nullptr)
 	{
-	case HAL_CAN_ERROR_TX_TERR0:	// Not considering an arbitration lost as error, auto-retransmit is on
-	case HAL_CAN_ERROR_TX_TERR1:
-	case HAL_CAN_ERROR_TX_TERR2:
-		txErrors++;
-		break;
-	case HAL_CAN_ERROR_RX_FOV0:
-	case HAL_CAN_ERROR_RX_FOV1:
-		rxErrors++;
-		break;
-	case HAL_CAN_ERROR_NONE:
-	default:
 		return;
 	}
+	/* The HAL accumulates error bits until they are reset, so each is tested on its own.
+	 * Lost arbitration is not an error, auto-retransmit is on. Error states are read from
+	 * ESR by CO_CANmodule_process(). */
+	const uint32_t err = HAL_CAN_GetError(hcan);
+	static const uint32_t terr[3] =
+	{ HAL_CAN_ERROR_TX_TERR0, HAL_CAN_ERROR_TX_TERR1, HAL_CAN_ERROR_TX_TERR2 };
+	static const uint32_t mailbox[3] =
+	{ CAN_TX_MAILBOX0, CAN_TX_MAILBOX1, CAN_TX_MAILBOX2 };
+	for (uint8_t i = 0; i < 3U; i++)
+	{
+		if ((err & terr[i]) != 0U)
+		{
+			CANmodule->txErrors++;
+			/* The failed mailbox is free again */
+			CO_CAN_TXISR(hcan, CANmodule, mailbox[i], false);
+		}
+	}
+	if ((err & HAL_CAN_ERROR_RX_FOV0) != 0U)
+	{
+		CANmodule->stats.rxOverflow++;
+	}
+	if ((err & HAL_CAN_ERROR_RX_FOV1) != 0U)
+	{
+		CANmodule->stats.rxOverflow++;
+	}
+	HAL_CAN_ResetError(hcan);
 }
@@ -52,6 +52,117 @@ extern "C" {
 /* Stack configuration override default values.
  * For more information see file CO_config.h. */
 
+/* CAN modules that can be initialized at the same time, one per controller */
+#ifndef CO_CAN_MODULES_MAX
+#define CO_CAN_MODULES_MAX 2
+#endif
+
+/* Set to 1 if the project runs CANopen on CAN2, which needs MX_CAN2_Init()
+ * from CubeMX */
+#ifndef CO_CAN_USE_CAN2
+#define CO_CAN_USE_CAN2 0
+#endif
+
+/* bxCAN hardware filter banks used by one CAN module. STM32 devices with one
+ * CAN have 14 banks, devices with CAN1 and CAN2 share CO_CAN_TOTAL_FILTER_BANKS,
+ * split at CO_CAN_SLAVE_START_FILTER_BANK: CAN1 uses the banks from
+ * CO_CAN_FIRST_FILTER_BANK up to the split, CAN2 the banks after it. Set
+ * CO_CAN_FILTER_BANKS to 0 to accept all frames and match them in software. */
+#ifndef CO_CAN_FILTER_BANKS
+#define CO_CAN_FILTER_BANKS 14
+#endif
+#ifndef CO_CAN_FIRST_FILTER_BANK
+#define CO_CAN_FIRST_FILTER_BANK 0
+#endif
+#ifndef CO_CAN_SLAVE_START_FILTER_BANK
+#define CO_CAN_SLAVE_START_FILTER_BANK 14
+#endif
+#ifndef CO_CAN_TOTAL_FILTER_BANKS
+#define CO_CAN_TOTAL_FILTER_BANKS 28
+#endif
+/* Filter match indexes available to one FIFO (four 16-bit list filters per bank) */
+#define CO_CAN_FILTER_COUNT (CO_CAN_FILTER_BANKS * 4)
+/* Filter match index without an rxArray entry, frame is matched in software */
+#define CO_CAN_FILTER_NONE 0xFFFFU
+
+/* Table from 11-bit identifier to rxArray index, used for data frames the
+ * filter match index does not dispatch. Costs 2 KiB of RAM per CAN module and
+ * needs rxSize below 255. Set to 0 to search rxArray linearly instead. */
+#ifndef CO_CAN_RX_TABLE
+#define CO_CAN_RX_TABLE 1
+#endif
+#define CO_CAN_RX_TABLE_SIZE 2048
+/* Identifier without an rxArray entry */
+#define CO_CAN_RX_TABLE_NONE 0xFFU
+
+/* Received frames waiting for the receive task (power of two). The bxCAN
+ * FIFOs hold 3 frames each, the queue absorbs bursts while the task runs. */
+#ifndef CO_CAN_RX_QUEUE_SIZE
+#define CO_CAN_RX_QUEUE_SIZE 32
+#endif
+/* Task running the CANopen receive callbacks, above the CANopen processing task */
+#ifndef CO_CAN_RX_TASK_PRIORITY
+#define CO_CAN_RX_TASK_PRIORITY osPriorityHigh
+#endif
+#ifndef CO_CAN_RX_TASK_STACK_SIZE
+#define CO_CAN_RX_TASK_STACK_SIZE (512 * 4)
+#endif
+
+/* Largest txSize, the transmit queue keeps one pending bit per txArray entry */
+#ifndef CO_CAN_TX_SIZE_MAX
+#define CO_CAN_TX_SIZE_MAX 64
+#endif
+#define CO_CAN_TX_PENDING_WORDS ((CO_CAN_TX_SIZE_MAX + 31) / 32)
+
+/* Bus-off recovery: the module is restarted this long after entering bus-off,
+ * the delay doubles on every bus-off within CO_CAN_BUSOFF_RECOVERY_MAX_MS of
+ * the last restart, up to that maximum. Unused if the bxCAN ABOM bit is set. */
+#ifndef CO_CAN_BUSOFF_RECOVERY_MS
+#define CO_CAN_BUSOFF_RECOVERY_MS 100
+#endif
+#ifndef CO_CAN_BUSOFF_RECOVERY_MAX_MS
+#define CO_CAN_BUSOFF_RECOVERY_MAX_MS 5000
+#endif
+/* Error state changes kept for diagnostics, see CO_CANerrorLog() */
+#ifndef CO_CAN_ERROR_LOG_SIZE
+#define CO_CAN_ERROR_LOG_SIZE 16
+#endif
+
+/* Time received frames from the bxCAN time-triggered mode counter (TTCM),
+ * which counts bit times and is captured at the start of each frame. Set to
+ * 0 to use the time the receive interrupt ran instead. */
+#ifndef CO_CAN_RX_TIMESTAMP_TTCM
+#define CO_CAN_RX_TIMESTAMP_TTCM 1
+#endif
+
+/* Record all received and sent frames to the SD card, see CO_CANcapture.h */
+#ifndef CO_CAN_CAPTURE
+#define CO_CAN_CAPTURE 0
+#endif
+
+/* CRC unit backend of crc16_ccitt(), built with CO_CONFIG_CRC16_EXTERNAL.
+ * Shorter blocks are left to the table code. */
+#ifndef CO_CRC16_HW_MIN
+#define CO_CRC16_HW_MIN 16
+#endif
+/* Memory-to-memory DMA handle that feeds blocks of at least CO_CRC16_DMA_MIN
+ * bytes to the CRC unit while the calling task sleeps, e.g.
+ * hdma_memtomem_dma1_channel1. CubeMX setup: source (peripheral) increment,
+ * fixed destination, byte width on both sides, interrupt enabled. Leave
+ * undefined to feed every block by CPU. */
+/* #define CO_CRC16_DMA hdma_memtomem_dma1_channel1 */
+#ifndef CO_CRC16_DMA_MIN
+#define CO_CRC16_DMA_MIN 1024
+#endif
+
+/* Period over which CO_CANmodule_process() computes the bus load (ms) */
+#ifndef CO_CAN_LOAD_WINDOW_MS
+#define CO_CAN_LOAD_WINDOW_MS 1000
+#endif
+/* ISR duration histogram, bin 0 counts runs under 128 CPU cycles, each
+ * further bin doubles the limit and the last one counts everything longer */
+#define CO_CAN_ISR_HISTOGRAM_BINS 8
+
 
 /* Basic definitions. If big endian, CO_SWAP_xx macros must swap bytes. */
 
@@ -79,6 +190,7 @@ typedef struct
 {
 	CAN_RxHeaderTypeDef RxHeader;
 	uint8_t data[8];
+	uint64_t timestamp_us; /* Start of frame on the CO_CANtime_us() timebase, CPU cycles while in rxQueue */
 } CO_CANrxMsg_t;
 
 
@@ -86,6 +198,7 @@ typedef struct
 #define CO_CANrxMsg_readIdent(msg) ((uint16_t)((CO_CANrxMsg_t *)msg)->RxHeader.StdId)
 #define CO_CANrxMsg_readDLC(msg)   ((uint8_t)((CO_CANrxMsg_t *)msg)->RxHeader.DLC)
 #define CO_CANrxMsg_readData(msg)  ((uint8_t *)((CO_CANrxMsg_t *)msg)->data)
+#define CO_CANrxMsg_readTimestamp(msg) (((CO_CANrxMsg_t *)msg)->timestamp_us)
 
 /* Received message object */
 typedef struct {
@@ -104,6 +217,59 @@ typedef struct {
     volatile bool_t syncFlag;
 } CO_CANtx_t;
 
+/* Frame classes by COB-ID, using the CANopen predefined connection set */
+typedef enum {
+    CO_CAN_CLASS_NMT,
+    CO_CAN_CLASS_SYNC,
+    CO_CAN_CLASS_EMCY,
+    CO_CAN_CLASS_TIME,
+    CO_CAN_CLASS_PDO,
+    CO_CAN_CLASS_SDO,
+    CO_CAN_CLASS_HB,
+    CO_CAN_CLASS_OTHER, /* LSS, gateway and application COB-IDs */
+    CO_CAN_CLASS_COUNT
+} CO_CANclass_t;
+
+/* Traffic statistics of a CAN module, see CO_CANgetStats() */
+typedef struct {
+    uint32_t rxFrames;
+    uint32_t txFrames; /* Frames the bus acknowledged */
+    uint32_t rxBytes;
+    uint32_t txBytes;
+    uint32_t rxClass[CO_CAN_CLASS_COUNT];
+    uint32_t txClass[CO_CAN_CLASS_COUNT];
+    uint32_t mailboxFull; /* CO_CANsend() calls that found all three mailboxes busy */
+    uint32_t rxIsrCycles[CO_CAN_ISR_HISTOGRAM_BINS];
+    uint32_t txIsrCycles[CO_CAN_ISR_HISTOGRAM_BINS];
+    uint32_t rxIsrMax; /* Longest receive interrupt (CPU cycles) */
+    uint32_t txIsrMax;
+    uint32_t busBits; /* Bits on the wire, excluding stuff bits */
+    uint32_t rxOverflow; /* Frames lost to a full FIFO or rxQueue */
+    uint16_t busLoad; /* Over the last CO_CAN_LOAD_WINDOW_MS, in 0.01 % */
+} CO_CANstats_t;
+
+/* Error state change, recorded by CO_CANmodule_process() */
+typedef struct {
+    uint32_t timestamp; /* HAL_GetTick() */
+    uint16_t status; /* CANerrorStatus after the change, CO_CAN_ERR... bits */
+    uint8_t tec; /* Transmit error counter */
+    uint8_t rec; /* Receive error counter */
+    uint8_t lec; /* Last error code (LEC) seen before the change, 0 if none */
+    bool_t recovery; /* The module was restarted out of bus-off */
+} CO_CANerrorEvent_t;
+
+/* Frame loaded into a transmit mailbox by CO_CANtxFill(). Kept until the mailbox
+ * completes, by then CO_CANtxFill() may already have loaded the next frame into
+ * the mailbox registers. */
+typedef struct {
+    bool_t loaded; /* Holds a frame not yet accounted for */
+    bool_t syncFlag;
+    uint8_t txIndex; /* txArray index */
+    uint8_t DLC;
+    uint16_t ident; /* CO_CANtx_t format, StdId << 2 with the RTR bit */
+    uint8_t data[8];
+} CO_CANtxMailbox_t;
+
 /* CAN module object */
 typedef struct {
     void *CANptr;
@@ -118,6 +284,50 @@ typedef struct {
     volatile bool_t firstCANtxMessage;
     volatile uint16_t CANtxCount;
     uint32_t errOld;
+    uint16_t rxErrors; /* FIFO reads the HAL failed */
+    uint16_t txErrors; /* Transmit errors reported by the HAL */
+    uint32_t rxOverflowOld; /* stats.rxOverflow at the last CO_CANmodule_process() */
+    uint8_t firstFilterBank;
+    uint8_t filterBanks;
+    /* rxArray index by filter match index, CO_CAN_FILTER_NONE if the frame must be matched in software */
+    volatile uint16_t rxFilterIndex[CO_CAN_FILTER_COUNT > 0 ? CO_CAN_FILTER_COUNT : 1];
+    bool_t useCANrxTable;
+#if CO_CAN_RX_TABLE
+    /* rxArray index of the first entry matching each identifier as a data frame */
+    volatile uint8_t rxTable[CO_CAN_RX_TABLE_SIZE];
+#endif
+    /* Frames moved out of the FIFOs by the interrupt, processed by the receive task */
+    CO_CANrxMsg_t rxQueue[CO_CAN_RX_QUEUE_SIZE];
+    volatile uint16_t rxQueueHead;
+    volatile uint16_t rxQueueTail;
+    uint16_t rxQueueHighWater;
+    uint32_t rxQueueOverflows;
+    /* Frames waiting for a mailbox, one bit per txArray entry in COB-ID
+     * order, the most significant bit of word 0 is the lowest COB-ID */
+    uint32_t txPending[CO_CAN_TX_PENDING_WORDS];
+    uint8_t txOrder[CO_CAN_TX_SIZE_MAX]; /* txArray index by pending bit */
+    uint8_t txBit[CO_CAN_TX_SIZE_MAX]; /* pending bit by txArray index */
+    uint8_t txMailboxSync; /* CAN_TX_MAILBOXx bits holding synchronous TPDOs */
+    CO_CANtxMailbox_t txMailbox[3];
+    uint32_t primask;
+    uint8_t lastErrorCode; /* Last bxCAN LEC other than "no error" */
+    bool_t busOff;
+    uint16_t busOffCount;
+    uint32_t busOffTime; /* HAL_GetTick() at bus-off or at the last restart attempt */
+    uint32_t busOffLeft; /* HAL_GetTick() when bus-off was last left */
+    uint32_t busOffDelay; /* Current bus-off recovery delay (ms) */
+    CO_CANerrorEvent_t errorLog[CO_CAN_ERROR_LOG_SIZE];
+    uint16_t errorLogCount; /* Events recorded since CO_CANmodule_init() */
+    uint16_t CANbitRate; /* kbit/s */
+    CO_CANstats_t stats;
+    uint32_t loadBits; /* stats.busBits at the start of the load window */
+    uint32_t loadTime; /* HAL_GetTick() at the start of the load window */
+    /* Maps the 16-bit TTCM counter to CPU cycles: start of the last received
+     * frame in cycles and in bit times */
+    uint64_t rxTimeCycles;
+    uint16_t rxTimeBits;
+    bool_t rxTimeValid;
+    uint32_t cyclesPerBit;
 } CO_CANmodule_t;
 
 
@@ -154,9 +364,26 @@ typedef struct {
 } CO_storage_entry_t;
 
 
-/* (un)lock critical section in CO_CANsend() */
-#define CO_LOCK_CAN_SEND(CAN_MODULE)
-#define CO_UNLOCK_CAN_SEND(CAN_MODULE)
+/* Copies up to count of the latest error state changes to events, oldest
+ * first, and returns how many were copied */
+uint16_t CO_CANerrorLog(const CO_CANmodule_t *CANmodule, CO_CANerrorEvent_t events[], uint16_t count);
+
+
+/* Microseconds on the timebase of received frame timestamps. Runs off the DWT
+ * cycle counter, which CO_CANmodule_process() must read at least once per
+ * wrap (25 s at 168 MHz). */
+uint64_t CO_CANtime_us(void);
+
+/* Copies the traffic statistics, safe to call from any task */
+void CO_CANgetStats(CO_CANmodule_t *CANmodule, CO_CANstats_t *stats);
+/* Clears the counters and histograms, bus load is kept */
+void CO_CANresetStats(CO_CANmodule_t *CANmodule);
+
+
+/* (un)lock critical section in CO_CANsend(), shared with the transmit interrupt */
+#define CO_LOCK_CAN_SEND(CAN_MODULE) \
+	{ (CAN_MODULE)->primask = __get_PRIMASK(); __disable_irq(); }
+#define CO_UNLOCK_CAN_SEND(CAN_MODULE) __set_PRIMASK((CAN_MODULE)->primask)
 
 /* (un)lock critical section in CO_errorReport() or CO_errorReset() */
 #define CO_LOCK_EMCY(CAN_MODULE)
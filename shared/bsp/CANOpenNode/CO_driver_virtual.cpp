@@ -0,0 +1,604 @@
+/*
+ * CO_driver_virtual.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#include <string.h>
+
+#include "301/CO_driver.h"
+
+/* Bits after the CRC: CRC delimiter, ACK slot and delimiter, end of frame and
+ * interframe space */
+#define CO_CAN_VIRTUAL_TAIL_BITS 13U
+/* Error flag and error delimiter, followed by the interframe space */
+#define CO_CAN_VIRTUAL_ERROR_BITS 17U
+/* A controller leaves bus-off after 128 x 11 recessive bits */
+#define CO_CAN_VIRTUAL_BUSOFF_BITS (128U * 11U)
+
+/* xorshift64*, good enough to spread the injected faults */
+static uint32_t CO_CANvirtualRandom(CO_CANvirtualBus_t *bus)
+{
+	uint64_t x = bus->random;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	bus->random = x;
+	return (uint32_t) ((x * 2685821657736338717ULL) >> 32);
+}
+
+static bool_t CO_CANvirtualFault(CO_CANvirtualBus_t *bus, uint32_t rate_ppm)
+{
+	return (rate_ppm > 0U && (CO_CANvirtualRandom(bus) % 1000000U) < rate_ppm) ? true : false;
+}
+
+uint32_t CO_CANvirtualFrameBits(uint16_t ident, bool_t rtr, uint8_t DLC, const uint8_t data[])
+{
+	uint8_t bits[19 + 64 + 15];
+	uint32_t n = 0U;
+	int i;
+
+	bits[n++] = 0U; /* SOF */
+	for (i = 10; i >= 0; i--)
+	{
+		bits[n++] = (uint8_t) ((ident >> i) & 1U);
+	}
+	bits[n++] = rtr ? 1U : 0U;
+	bits[n++] = 0U; /* IDE */
+	bits[n++] = 0U; /* r0 */
+	for (i = 3; i >= 0; i--)
+	{
+		bits[n++] = (uint8_t) ((DLC >> i) & 1U);
+	}
+	const uint8_t bytes = rtr ? 0U : ((DLC > 8U) ? 8U : DLC);
+	for (uint8_t b = 0U; b < bytes; b++)
+	{
+		for (i = 7; i >= 0; i--)
+		{
+			bits[n++] = (uint8_t) ((data[b] >> i) & 1U);
+		}
+	}
+
+	/* CRC-15 from the start of frame to the end of the data */
+	uint16_t crc = 0U;
+	for (uint32_t k = 0U; k < n; k++)
+	{
+		const uint16_t next = (uint16_t) (bits[k] ^ ((crc >> 14) & 1U));
+		crc = (uint16_t) ((crc << 1) & 0x7FFFU);
+		if (next != 0U)
+		{
+			crc ^= 0x4599U;
+		}
+	}
+	for (i = 14; i >= 0; i--)
+	{
+		bits[n++] = (uint8_t) ((crc >> i) & 1U);
+	}
+
+	/* Five equal bits are followed by a stuff bit, which starts the next run */
+	uint32_t stuffed = 0U;
+	uint32_t run = 1U;
+	uint8_t last = bits[0];
+	for (uint32_t k = 1U; k < n; k++)
+	{
+		if (bits[k] == last)
+		{
+			run++;
+		}
+		else
+		{
+			last = bits[k];
+			run = 1U;
+		}
+		if (run == 5U)
+		{
+			stuffed++;
+			last ^= 1U;
+			run = 1U;
+		}
+	}
+
+	return n + stuffed + CO_CAN_VIRTUAL_TAIL_BITS;
+}
+
+/* Highest priority frame the module has queued */
+static CO_CANtx_t* CO_CANvirtualNext(CO_CANmodule_t *CANmodule)
+{
+	CO_CANtx_t *next = NULL;
+	for (uint16_t i = 0U; i < CANmodule->txSize; i++)
+	{
+		CO_CANtx_t *buffer = &CANmodule->txArray[i];
+		if (buffer->bufferFull && (next == NULL || buffer->ident < next->ident))
+		{
+			next = buffer;
+		}
+	}
+	return next;
+}
+
+static bool_t CO_CANvirtualOnBus(const CO_CANmodule_t *CANmodule)
+{
+	return (CANmodule->CANnormal && !CANmodule->busOff) ? true : false;
+}
+
+/* Arbitrates the next frame if the bus is free before end */
+static bool_t CO_CANvirtualStart(CO_CANvirtualBus_t *bus, uint64_t end)
+{
+	const uint64_t start = (bus->idle_ns > bus->time_ns) ? bus->idle_ns : bus->time_ns;
+	if (start >= end)
+	{
+		return false;
+	}
+
+	CO_CANmodule_t *sender = NULL;
+	CO_CANtx_t *frame = NULL;
+	for (uint16_t i = 0U; i < bus->moduleCount; i++)
+	{
+		CO_CANmodule_t *CANmodule = bus->modules[i];
+		if (CANmodule->busOff && CANmodule->busOffEnd_ns <= start)
+		{
+			CANmodule->busOff = false;
+			CANmodule->tec = 0U;
+			CANmodule->rec = 0U;
+		}
+		if (!CO_CANvirtualOnBus(CANmodule) || CANmodule->CANtxCount == 0U)
+		{
+			continue;
+		}
+		CO_CANtx_t *next = CO_CANvirtualNext(CANmodule);
+		if (next != NULL && (frame == NULL || next->ident < frame->ident))
+		{
+			sender = CANmodule;
+			frame = next;
+		}
+	}
+	if (frame == NULL)
+	{
+		return false;
+	}
+
+	/* The frame is copied like into a mailbox, later changes to the buffer
+	 * don't affect it */
+	bus->frame.ident = (uint16_t) (frame->ident >> 1);
+	bus->frame.rtr = (uint8_t) (frame->ident & 1U);
+	bus->frame.DLC = frame->DLC;
+	memcpy(bus->frame.data, frame->data, sizeof(bus->frame.data));
+	bus->frame.timestamp_us = start / 1000U;
+	bus->frameBits = CO_CANvirtualFrameBits(bus->frame.ident, bus->frame.rtr,
+			bus->frame.DLC, bus->frame.data);
+	bus->frameError = CO_CANvirtualFault(bus, bus->errorRate_ppm);
+	if (bus->frameError)
+	{
+		/* Destroyed somewhere before the end of frame */
+		bus->frameBits = CO_CANvirtualRandom(bus) % (bus->frameBits - 10U)
+				+ CO_CAN_VIRTUAL_ERROR_BITS;
+	}
+	bus->frameEnd_ns = start + (uint64_t) bus->frameBits * bus->bitTime_ns;
+	bus->sender = sender;
+	sender->txActive = frame;
+	return true;
+}
+
+/* Delivers the frame on the bus, or counts its error frame */
+static void CO_CANvirtualFinish(CO_CANvirtualBus_t *bus)
+{
+	CO_CANmodule_t *sender = bus->sender;
+	CO_CANtx_t *frame = sender->txActive;
+
+	bus->idle_ns = bus->frameEnd_ns;
+	bus->stats.bits += bus->frameBits;
+	bus->stats.busy_ns += (uint64_t) bus->frameBits * bus->bitTime_ns;
+	sender->txActive = NULL;
+	bus->sender = NULL;
+
+	if (bus->frameError)
+	{
+		/* The frame stays queued and is arbitrated again */
+		bus->stats.errorFrames++;
+		sender->tec += 8U;
+		if (sender->tec >= 256U)
+		{
+			sender->busOff = true;
+			sender->busOffEnd_ns = bus->frameEnd_ns
+					+ (uint64_t) CO_CAN_VIRTUAL_BUSOFF_BITS * bus->bitTime_ns;
+		}
+		for (uint16_t i = 0U; i < bus->moduleCount; i++)
+		{
+			CO_CANmodule_t *CANmodule = bus->modules[i];
+			if (CANmodule != sender && CO_CANvirtualOnBus(CANmodule) && CANmodule->rec < 255U)
+			{
+				CANmodule->rec++;
+			}
+		}
+		return;
+	}
+
+	bus->stats.frames++;
+	if (frame->bufferFull)
+	{
+		frame->bufferFull = false;
+		sender->CANtxCount--;
+	}
+	sender->firstCANtxMessage = false;
+	sender->txFrames++;
+	if (sender->tec > 0U)
+	{
+		sender->tec--;
+	}
+
+	const uint16_t key = (uint16_t) ((bus->frame.ident << 1) | bus->frame.rtr);
+	for (uint16_t i = 0U; i < bus->moduleCount; i++)
+	{
+		CO_CANmodule_t *CANmodule = bus->modules[i];
+		if (CANmodule == sender || !CO_CANvirtualOnBus(CANmodule))
+		{
+			continue;
+		}
+		if (CO_CANvirtualFault(bus, bus->lossRate_ppm))
+		{
+			CANmodule->rxLost++;
+			bus->stats.lostFrames++;
+			continue;
+		}
+		if (CANmodule->rec > 0U)
+		{
+			CANmodule->rec--;
+		}
+		CANmodule->rxFrames++;
+
+		/* First matching buffer, like the other targets without filters */
+		for (uint16_t j = 0U; j < CANmodule->rxSize; j++)
+		{
+			CO_CANrx_t *buffer = &CANmodule->rxArray[j];
+			if (buffer->CANrx_callback != NULL && ((key ^ buffer->ident) & buffer->mask) == 0U)
+			{
+				buffer->CANrx_callback(buffer->object, (void*) &bus->frame);
+				break;
+			}
+		}
+	}
+}
+
+void CO_CANvirtualBus_init(CO_CANvirtualBus_t *bus, uint16_t CANbitRate)
+{
+	pthread_mutexattr_t attr;
+
+	memset(bus, 0, sizeof(*bus));
+	bus->bitTime_ns = (CANbitRate > 0U) ? 1000000U / CANbitRate : 0U;
+	bus->random = 1U;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&bus->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+void CO_CANvirtualBus_delete(CO_CANvirtualBus_t *bus)
+{
+	pthread_mutex_destroy(&bus->lock);
+}
+
+void CO_CANvirtualBus_setFaults(CO_CANvirtualBus_t *bus, uint32_t lossRate_ppm,
+		uint32_t errorRate_ppm, uint64_t seed)
+{
+	pthread_mutex_lock(&bus->lock);
+	bus->lossRate_ppm = lossRate_ppm;
+	bus->errorRate_ppm = errorRate_ppm;
+	bus->random = (seed != 0U) ? seed : 1U;
+	pthread_mutex_unlock(&bus->lock);
+}
+
+void CO_CANvirtualBus_run(CO_CANvirtualBus_t *bus, uint32_t timeDifference_us)
+{
+	pthread_mutex_lock(&bus->lock);
+	const uint64_t end = bus->time_ns + (uint64_t) timeDifference_us * 1000U;
+	for (;;)
+	{
+		if (bus->sender == NULL && !CO_CANvirtualStart(bus, end))
+		{
+			break;
+		}
+		if (bus->frameEnd_ns > end)
+		{
+			break;
+		}
+		CO_CANvirtualFinish(bus);
+	}
+	bus->time_ns = end;
+	pthread_mutex_unlock(&bus->lock);
+}
+
+uint64_t CO_CANvirtualBus_time_us(CO_CANvirtualBus_t *bus)
+{
+	pthread_mutex_lock(&bus->lock);
+	const uint64_t time_us = bus->time_ns / 1000U;
+	pthread_mutex_unlock(&bus->lock);
+	return time_us;
+}
+
+void CO_CANvirtualBus_getStats(CO_CANvirtualBus_t *bus, CO_CANvirtualStats_t *stats)
+{
+	pthread_mutex_lock(&bus->lock);
+	*stats = bus->stats;
+	pthread_mutex_unlock(&bus->lock);
+}
+
+void CO_CANsetConfigurationMode(void *CANptr)
+{
+	/* Modules only take part in the bus in normal mode */
+	(void) CANptr;
+}
+
+void CO_CANsetNormalMode(CO_CANmodule_t *CANmodule)
+{
+	CANmodule->CANnormal = true;
+}
+
+CO_ReturnError_t CO_CANmodule_init(CO_CANmodule_t *CANmodule, void *CANptr,
+		CO_CANrx_t rxArray[], uint16_t rxSize, CO_CANtx_t txArray[],
+		uint16_t txSize, uint16_t CANbitRate)
+{
+	uint16_t i;
+
+	/* verify arguments */
+	if (CANmodule == NULL || CANptr == NULL || rxArray == NULL || txArray == NULL)
+	{
+		return CO_ERROR_ILLEGAL_ARGUMENT;
+	}
+	CO_CANvirtualBus_t *bus = (CO_CANvirtualBus_t*) CANptr;
+	if ((uint32_t) CANbitRate * bus->bitTime_ns != 1000000U)
+	{
+		return CO_ERROR_ILLEGAL_BAUDRATE;
+	}
+
+	/* A module initialized again without CO_CANmodule_disable() stays attached */
+	pthread_mutex_lock(&bus->lock);
+	bool_t attached = false;
+	for (i = 0U; i < bus->moduleCount; i++)
+	{
+		attached = (bus->modules[i] == CANmodule) ? true : attached;
+	}
+	if (!attached && bus->moduleCount >= CO_CAN_VIRTUAL_MODULES_MAX)
+	{
+		pthread_mutex_unlock(&bus->lock);
+		return CO_ERROR_OUT_OF_MEMORY;
+	}
+
+	/* Configure object variables */
+	CANmodule->CANptr = CANptr;
+	CANmodule->rxArray = rxArray;
+	CANmodule->rxSize = rxSize;
+	CANmodule->txArray = txArray;
+	CANmodule->txSize = txSize;
+	CANmodule->CANerrorStatus = 0;
+	CANmodule->CANnormal = false;
+	CANmodule->useCANrxFilters = false;
+	CANmodule->bufferInhibitFlag = false;
+	CANmodule->firstCANtxMessage = true;
+	CANmodule->CANtxCount = 0U;
+	CANmodule->errOld = 0U;
+	CANmodule->tec = 0U;
+	CANmodule->rec = 0U;
+	CANmodule->busOff = false;
+	CANmodule->busOffEnd_ns = 0U;
+	CANmodule->txActive = NULL;
+	CANmodule->rxFrames = 0U;
+	CANmodule->txFrames = 0U;
+	CANmodule->rxLost = 0U;
+
+	for (i = 0U; i < rxSize; i++)
+	{
+		rxArray[i].ident = 0U;
+		rxArray[i].mask = 0xFFFFU;
+		rxArray[i].object = NULL;
+		rxArray[i].CANrx_callback = NULL;
+	}
+	for (i = 0U; i < txSize; i++)
+	{
+		txArray[i].bufferFull = false;
+	}
+
+	if (!attached)
+	{
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(&CANmodule->lock, &attr);
+		pthread_mutexattr_destroy(&attr);
+		bus->modules[bus->moduleCount++] = CANmodule;
+	}
+	pthread_mutex_unlock(&bus->lock);
+
+	return CO_ERROR_NO;
+}
+
+void CO_CANmodule_disable(CO_CANmodule_t *CANmodule)
+{
+	if (CANmodule == NULL || CANmodule->CANptr == NULL)
+	{
+		return;
+	}
+
+	CO_CANvirtualBus_t *bus = (CO_CANvirtualBus_t*) CANmodule->CANptr;
+	bool_t attached = false;
+	pthread_mutex_lock(&bus->lock);
+	for (uint16_t i = 0U; i < bus->moduleCount; i++)
+	{
+		if (bus->modules[i] == CANmodule)
+		{
+			bus->modules[i] = bus->modules[--bus->moduleCount];
+			attached = true;
+			break;
+		}
+	}
+	/* The frame on the bus leaves with its sender */
+	if (attached && bus->sender == CANmodule)
+	{
+		bus->sender = NULL;
+		CANmodule->txActive = NULL;
+	}
+	CANmodule->CANnormal = false;
+	pthread_mutex_unlock(&bus->lock);
+
+	if (attached)
+	{
+		pthread_mutex_destroy(&CANmodule->lock);
+	}
+}
+
+CO_ReturnError_t CO_CANrxBufferInit(CO_CANmodule_t *CANmodule, uint16_t index,
+		uint16_t ident, uint16_t mask, bool_t rtr, void *object,
+		void (*CANrx_callback)(void *object, void *message))
+{
+	CO_ReturnError_t ret = CO_ERROR_NO;
+
+	if ((CANmodule != NULL) && (object != NULL) && (CANrx_callback != NULL)
+			&& (index < CANmodule->rxSize))
+	{
+		CO_CANrx_t *buffer = &CANmodule->rxArray[index];
+
+		CO_LOCK_CAN_SEND(CANmodule);
+		buffer->object = object;
+		buffer->CANrx_callback = CANrx_callback;
+		buffer->ident = (uint16_t) (((ident & 0x07FFU) << 1) | (rtr ? 1U : 0U));
+		buffer->mask = (uint16_t) (((mask & 0x07FFU) << 1) | 1U);
+		CO_UNLOCK_CAN_SEND(CANmodule);
+	}
+	else
+	{
+		ret = CO_ERROR_ILLEGAL_ARGUMENT;
+	}
+
+	return ret;
+}
+
+CO_CANtx_t* CO_CANtxBufferInit(CO_CANmodule_t *CANmodule, uint16_t index,
+		uint16_t ident, bool_t rtr, uint8_t noOfBytes, bool_t syncFlag)
+{
+	CO_CANtx_t *buffer = NULL;
+
+	if ((CANmodule != NULL) && (index < CANmodule->txSize))
+	{
+		buffer = &CANmodule->txArray[index];
+
+		CO_LOCK_CAN_SEND(CANmodule);
+		/* Arbitration order: COB-ID, then the RTR bit */
+		buffer->ident = ((uint32_t) (ident & 0x07FFU) << 1) | (rtr ? 1U : 0U);
+		buffer->DLC = noOfBytes;
+		if (buffer->bufferFull)
+		{
+			buffer->bufferFull = false;
+			CANmodule->CANtxCount--;
+		}
+		buffer->syncFlag = syncFlag;
+		CO_UNLOCK_CAN_SEND(CANmodule);
+	}
+
+	return buffer;
+}
+
+CO_ReturnError_t CO_CANsend(CO_CANmodule_t *CANmodule, CO_CANtx_t *buffer)
+{
+	CO_ReturnError_t err = CO_ERROR_NO;
+
+	CO_LOCK_CAN_SEND(CANmodule);
+	/* Verify overflow */
+	if (buffer->bufferFull)
+	{
+		if (!CANmodule->firstCANtxMessage)
+		{
+			/* don't set error, if bootup message is still on buffers */
+			CANmodule->CANerrorStatus |= CO_CAN_ERRTX_OVERFLOW;
+		}
+		err = CO_ERROR_TX_OVERFLOW;
+	}
+	else
+	{
+		/* Arbitrated by CO_CANvirtualBus_run() */
+		buffer->bufferFull = true;
+		CANmodule->CANtxCount++;
+	}
+	CO_UNLOCK_CAN_SEND(CANmodule);
+
+	return err;
+}
+
+void CO_CANclearPendingSyncPDOs(CO_CANmodule_t *CANmodule)
+{
+	uint32_t tpdoDeleted = 0U;
+
+	CO_LOCK_CAN_SEND(CANmodule);
+	/* delete pending synchronous TPDOs, except the one already on the bus */
+	for (uint16_t i = 0U; i < CANmodule->txSize; i++)
+	{
+		CO_CANtx_t *buffer = &CANmodule->txArray[i];
+		if (buffer->bufferFull && buffer->syncFlag && buffer != CANmodule->txActive)
+		{
+			buffer->bufferFull = false;
+			CANmodule->CANtxCount--;
+			tpdoDeleted = 1U;
+		}
+	}
+	CO_UNLOCK_CAN_SEND(CANmodule);
+
+	if (tpdoDeleted != 0U)
+	{
+		CANmodule->CANerrorStatus |= CO_CAN_ERRTX_PDO_LATE;
+	}
+}
+
+void CO_CANmodule_process(CO_CANmodule_t *CANmodule)
+{
+	const uint32_t tec = CANmodule->tec;
+	const uint32_t rec = CANmodule->rec;
+	const uint32_t err = tec | (rec << 16) | (CANmodule->busOff ? 0x80000000UL : 0U);
+
+	if (CANmodule->errOld != err)
+	{
+		uint16_t status = CANmodule->CANerrorStatus;
+
+		CANmodule->errOld = err;
+
+		if (CANmodule->busOff)
+		{
+			/* bus off */
+			status |= CO_CAN_ERRTX_BUS_OFF;
+		}
+		else
+		{
+			/* recalculate CANerrorStatus, first clear some flags */
+			status &= 0xFFFF
+					^ (CO_CAN_ERRTX_BUS_OFF | CO_CAN_ERRRX_WARNING
+							| CO_CAN_ERRRX_PASSIVE | CO_CAN_ERRTX_WARNING
+							| CO_CAN_ERRTX_PASSIVE);
+
+			/* rx bus warning or passive */
+			if (rec >= 128)
+			{
+				status |= CO_CAN_ERRRX_WARNING | CO_CAN_ERRRX_PASSIVE;
+			}
+			else if (rec >= 96)
+			{
+				status |= CO_CAN_ERRRX_WARNING;
+			}
+
+			/* tx bus warning or passive */
+			if (tec >= 128)
+			{
+				status |= CO_CAN_ERRTX_WARNING | CO_CAN_ERRTX_PASSIVE;
+			}
+			else if (tec >= 96)
+			{
+				status |= CO_CAN_ERRTX_WARNING;
+			}
+
+			/* if not tx passive clear also overflow */
+			if ((status & CO_CAN_ERRTX_PASSIVE) == 0)
+			{
+				status &= 0xFFFF ^ CO_CAN_ERRTX_OVERFLOW;
+			}
+		}
+
+		CANmodule->CANerrorStatus = status;
+	}
+}
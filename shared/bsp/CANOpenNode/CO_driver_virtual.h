@@ -0,0 +1,218 @@
+/*
+ * CO_driver_virtual.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_BSP_CANOPENNODE_CO_DRIVER_VIRTUAL_H_
+#define SRC_SHARED_BSP_CANOPENNODE_CO_DRIVER_VIRTUAL_H_
+
+/* CANopenNode target for host builds, selected with CO_DRIVER_VIRTUAL instead
+ * of the STM32 driver. CAN modules attach to an in-process virtual bus, which
+ * runs on its own clock: CO_CANvirtualBus_run() moves it forward, arbitrates
+ * the queued frames by COB-ID and delivers each frame to the other modules
+ * when its last bit has been sent. Frame lengths include stuff bits, so the
+ * bus time used matches a real bus at the same bit rate. */
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdbool>
+#include <cstdint>
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+#include <pthread.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN modules that can be attached to one bus */
+#ifndef CO_CAN_VIRTUAL_MODULES_MAX
+#define CO_CAN_VIRTUAL_MODULES_MAX 128
+#endif
+
+#define CO_LITTLE_ENDIAN
+#define CO_SWAP_16(x) (x)
+#define CO_SWAP_32(x) (x)
+#define CO_SWAP_64(x) (x)
+
+/* NULL is defined in stddef.h */
+/* true and false are defined in stdbool.h */
+/* int8_t to uint64_t are defined in stdint.h */
+typedef uint_fast8_t            bool_t;
+typedef float                   float32_t;
+typedef double                  float64_t;
+
+
+typedef struct
+{
+	uint16_t ident; /* 11-bit COB-ID */
+	uint8_t rtr;
+	uint8_t DLC;
+	uint8_t data[8];
+	uint64_t timestamp_us; /* Start of frame on the bus clock */
+} CO_CANrxMsg_t;
+
+
+/* Access to received CAN message */
+#define CO_CANrxMsg_readIdent(msg) (((CO_CANrxMsg_t *)msg)->ident)
+#define CO_CANrxMsg_readDLC(msg)   (((CO_CANrxMsg_t *)msg)->DLC)
+#define CO_CANrxMsg_readData(msg)  ((uint8_t *)((CO_CANrxMsg_t *)msg)->data)
+#define CO_CANrxMsg_readTimestamp(msg) (((CO_CANrxMsg_t *)msg)->timestamp_us)
+
+/* Received message object, ident and mask hold the COB-ID shifted left by one
+ * with the RTR bit below it, the order in which they are arbitrated */
+typedef struct {
+    uint16_t ident;
+    uint16_t mask;
+    void *object;
+    void (*CANrx_callback)(void *object, void *message);
+} CO_CANrx_t;
+
+/* Transmit message object */
+typedef struct {
+    uint32_t ident;
+    uint8_t DLC;
+    uint8_t data[8];
+    volatile bool_t bufferFull;
+    volatile bool_t syncFlag;
+} CO_CANtx_t;
+
+struct CO_CANvirtualBus;
+
+/* CAN module object */
+typedef struct {
+    void *CANptr; /* CO_CANvirtualBus_t the module is attached to */
+    CO_CANrx_t *rxArray;
+    uint16_t rxSize;
+    CO_CANtx_t *txArray;
+    uint16_t txSize;
+    uint16_t CANerrorStatus;
+    volatile bool_t CANnormal;
+    volatile bool_t useCANrxFilters;
+    volatile bool_t bufferInhibitFlag;
+    volatile bool_t firstCANtxMessage;
+    volatile uint16_t CANtxCount;
+    uint32_t errOld;
+    uint16_t tec; /* Transmit and receive error counters, as kept by a controller */
+    uint16_t rec;
+    bool_t busOff;
+    uint64_t busOffEnd_ns; /* Bus clock when the module rejoins after bus-off */
+    CO_CANtx_t *txActive; /* Buffer whose frame is on the bus, it can't be aborted */
+    uint32_t rxFrames;
+    uint32_t txFrames;
+    uint32_t rxLost; /* Frames dropped by the loss injection */
+    pthread_mutex_t lock; /* Object Dictionary and emergency, recursive */
+} CO_CANmodule_t;
+
+/* Bus statistics, see CO_CANvirtualBus_getStats() */
+typedef struct {
+    uint64_t frames; /* Frames sent without error */
+    uint64_t bits; /* Bus time used, including error frames, in bits */
+    uint64_t busy_ns; /* Bus time used */
+    uint32_t errorFrames;
+    uint32_t lostFrames; /* Deliveries dropped, counted per receiver */
+} CO_CANvirtualStats_t;
+
+/* Virtual CAN bus, shared by the modules initialized with it as CANptr */
+typedef struct CO_CANvirtualBus {
+    uint32_t bitTime_ns;
+    uint64_t time_ns; /* Bus clock */
+    uint64_t idle_ns; /* Bus clock when the bus is free for the next frame */
+    CO_CANmodule_t *modules[CO_CAN_VIRTUAL_MODULES_MAX];
+    uint16_t moduleCount;
+    /* Frame on the bus, copied from its buffer at the start of frame */
+    CO_CANmodule_t *sender;
+    CO_CANrxMsg_t frame;
+    uint64_t frameEnd_ns;
+    bool_t frameError;
+    uint32_t frameBits;
+    /* Fault injection, in parts per million */
+    uint32_t lossRate_ppm; /* A receiver misses the frame */
+    uint32_t errorRate_ppm; /* The frame is destroyed by an error frame and retransmitted */
+    uint64_t random;
+    CO_CANvirtualStats_t stats;
+    pthread_mutex_t lock; /* Recursive, held while frames are delivered */
+} CO_CANvirtualBus_t;
+
+
+/* Data storage object for one entry */
+typedef struct {
+    /** Address of data to store, always required. */
+    void *addr;
+    /** Length of data to store, always required. */
+    size_t len;
+    /** Sub index in OD objects 1010 and 1011, from 2 to 127. Writing
+     * 0x65766173 to 1010,subIndexOD will store data to non-volatile memory.
+     * Writing 0x64616F6C to 1011,subIndexOD will restore default data, always
+     * required. */
+    uint8_t subIndexOD;
+    /** Attribute from @ref CO_storage_attributes_t, always required. */
+    uint8_t attr;
+    /** Pointer to storage module, target system specific usage, required with
+     * @ref CO_storage_eeprom. */
+    void *storageModule;
+    /** CRC checksum of the data stored in eeprom, set on store, required with
+     * @ref CO_storage_eeprom. */
+    uint16_t crc;
+    /** Address of entry signature inside eeprom, set by init, required with
+     * @ref CO_storage_eeprom. */
+    size_t eepromAddrSignature;
+    /** Address of data inside eeprom, set by init, required with
+     * @ref CO_storage_eeprom. */
+    size_t eepromAddr;
+    /** Offset of next byte being updated by automatic storage, required with
+     * @ref CO_storage_eeprom. */
+    size_t offset;
+    /** Additional target specific parameters, optional. */
+    void *additionalParameters;
+} CO_storage_entry_t;
+
+
+/* Sets up an idle bus at CANbitRate (kbit/s), modules must use the same rate */
+void CO_CANvirtualBus_init(CO_CANvirtualBus_t *bus, uint16_t CANbitRate);
+/* Destroys the bus lock, detach the modules first */
+void CO_CANvirtualBus_delete(CO_CANvirtualBus_t *bus);
+/* Sets the fault injection rates (ppm) and seeds their random generator */
+void CO_CANvirtualBus_setFaults(CO_CANvirtualBus_t *bus, uint32_t lossRate_ppm,
+        uint32_t errorRate_ppm, uint64_t seed);
+/* Moves the bus clock forward, sending the queued frames that fit. Frames
+ * queued since the last call become ready at the old bus clock. */
+void CO_CANvirtualBus_run(CO_CANvirtualBus_t *bus, uint32_t timeDifference_us);
+uint64_t CO_CANvirtualBus_time_us(CO_CANvirtualBus_t *bus);
+void CO_CANvirtualBus_getStats(CO_CANvirtualBus_t *bus, CO_CANvirtualStats_t *stats);
+/* Bus time in bits a data frame takes, stuff bits and interframe space included */
+uint32_t CO_CANvirtualFrameBits(uint16_t ident, bool_t rtr, uint8_t DLC, const uint8_t data[]);
+
+
+/* (un)lock critical section in CO_CANsend(), shared with the bus */
+#define CO_LOCK_CAN_SEND(CAN_MODULE) \
+	pthread_mutex_lock(&((CO_CANvirtualBus_t *)(CAN_MODULE)->CANptr)->lock)
+#define CO_UNLOCK_CAN_SEND(CAN_MODULE) \
+	pthread_mutex_unlock(&((CO_CANvirtualBus_t *)(CAN_MODULE)->CANptr)->lock)
+
+/* (un)lock critical section in CO_errorReport() or CO_errorReset() */
+#define CO_LOCK_EMCY(CAN_MODULE) pthread_mutex_lock(&(CAN_MODULE)->lock)
+#define CO_UNLOCK_EMCY(CAN_MODULE) pthread_mutex_unlock(&(CAN_MODULE)->lock)
+
+/* (un)lock critical section when accessing Object Dictionary */
+#define CO_LOCK_OD(CAN_MODULE) pthread_mutex_lock(&(CAN_MODULE)->lock)
+#define CO_UNLOCK_OD(CAN_MODULE) pthread_mutex_unlock(&(CAN_MODULE)->lock)
+
+/* Synchronization between CAN receive and message processing threads. */
+#define CO_MemoryBarrier() __sync_synchronize()
+#define CO_FLAG_READ(rxNew) ((rxNew) != NULL)
+#define CO_FLAG_SET(rxNew) {CO_MemoryBarrier(); rxNew = (void*)1L;}
+#define CO_FLAG_CLEAR(rxNew) {CO_MemoryBarrier(); rxNew = NULL;}
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SRC_SHARED_BSP_CANOPENNODE_CO_DRIVER_VIRTUAL_H_ */
@@ -0,0 +1,131 @@
+/*
+ * canreplay.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+/* Host tool: replays a CAN capture from the SD card into the virtual bus and
+ * reports how the bus kept up. Built against the virtual driver, e.g.
+ *
+ *   g++ -DCO_DRIVER_VIRTUAL -I shared -I shared/CANopenNode -I <app>/Core/Inc
+ *       shared/bsp/CANOpenNode/tools/canreplay.cpp
+ *       shared/bsp/CANOpenNode/CO_CANreplay.cpp
+ *       shared/bsp/CANOpenNode/CO_driver_virtual.cpp -lpthread
+ *
+ *   canreplay <capture> [speed] [can2] [tx]
+ *
+ * speed 1 keeps the captured timing, 10 plays it ten times faster and 0 as
+ * fast as the bus allows. "can2" replays the second controller, "tx" also
+ * replays the frames the capturing node sent. To benchmark a stack, attach its
+ * CO_CANmodule_t to the same bus and process it inside the loop below. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "bsp/CANOpenNode/CO_CANreplay.h"
+
+/* Bus clock step (us), also the resolution of the replayed timing */
+#define CANREPLAY_STEP_US 50U
+
+namespace
+{
+
+struct Listener
+{
+	CO_CANmodule_t CANmodule;
+	CO_CANrx_t rxArray[1];
+	CO_CANtx_t txArray[1];
+	uint32_t frames;
+	uint32_t bytes;
+};
+
+void listenerReceive(void *object, void *message)
+{
+	Listener *listener = (Listener*) object;
+	listener->frames++;
+	listener->bytes += CO_CANrxMsg_readDLC(message);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <capture> [speed] [can2] [tx]\n", argv[0]);
+		return 2;
+	}
+	const float64_t speed = (argc > 2) ? atof(argv[2]) : 1.0;
+	uint8_t channel = 0U;
+	bool_t includeTx = false;
+	for (int i = 3; i < argc; i++)
+	{
+		channel = (strcmp(argv[i], "can2") == 0) ? CO_CAN_CAPTURE_CAN2 : channel;
+		includeTx = (strcmp(argv[i], "tx") == 0) ? true : includeTx;
+	}
+
+	FILE *file = fopen(argv[1], "rb");
+	if (file == NULL)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	std::vector<uint8_t> capture;
+	uint8_t chunk[4096];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+	{
+		capture.insert(capture.end(), chunk, chunk + n);
+	}
+	fclose(file);
+
+	CO_CANcaptureHeader_t header;
+	if (capture.size() < sizeof(header))
+	{
+		fprintf(stderr, "%s: not a capture\n", argv[1]);
+		return 1;
+	}
+	memcpy(&header, capture.data(), sizeof(header));
+
+	static CO_CANvirtualBus_t bus;
+	static CO_CANreplay_t replay;
+	static Listener listener;
+	CO_CANvirtualBus_init(&bus, header.bitRate);
+	CO_ReturnError_t err = CO_CANreplay_init(&replay, &bus, capture.data(), capture.size(),
+			channel, includeTx, speed);
+	if (err != CO_ERROR_NO)
+	{
+		fprintf(stderr, "%s: can't replay (%d)\n", argv[1], (int) err);
+		return 1;
+	}
+	CO_CANmodule_init(&listener.CANmodule, &bus, listener.rxArray, 1U, listener.txArray, 1U,
+			header.bitRate);
+	CO_CANrxBufferInit(&listener.CANmodule, 0U, 0U, 0U, false, &listener, listenerReceive);
+	listener.rxArray[0].mask = 0U; /* RTR frames too */
+	CO_CANsetNormalMode(&listener.CANmodule);
+
+	while (CO_CANreplay_process(&replay))
+	{
+		CO_CANvirtualBus_run(&bus, CANREPLAY_STEP_US);
+	}
+	CO_CANvirtualBus_run(&bus, CANREPLAY_STEP_US);
+
+	CO_CANvirtualStats_t stats;
+	CO_CANvirtualBus_getStats(&bus, &stats);
+	const uint64_t duration_us = CO_CANvirtualBus_time_us(&bus);
+	printf("frames %u (%u data bytes), %u missing from the capture\n", listener.frames,
+			listener.bytes, replay.lost);
+	printf("bus time %.3f s, load %.1f %%, latest frame %.3f ms behind the capture\n",
+			(double) duration_us / 1e6,
+			(duration_us > 0U) ? 100.0 * (double) stats.busy_ns / ((double) duration_us * 1e3) : 0.0,
+			(double) replay.maxLate_us / 1e3);
+
+	CO_CANreplay_delete(&replay);
+	CO_CANmodule_disable(&listener.CANmodule);
+	CO_CANvirtualBus_delete(&bus);
+	return 0;
+}
@@ -9,71 +9,238 @@
 
 #include <string.h>
 #include <cstdarg>
+#include <algorithm>
 
 #include "Logging/printf.h"
 
 
+// Dispatch table from HAL handle to instance for the shared HAL callbacks
 typedef struct
 {
-	char *str;
-	size_t length;
-} message;
+	UART_HandleTypeDef *uart;
+	UARTManager *manager;
+} Instance;
 
-static UARTManager *manager = nullptr;
-static char *msgToFree = nullptr;
-static int msgSize = 0;
+static Instance instances[UART_MAX_INSTANCES];
 
 
-UARTManager::UARTManager(UART_HandleTypeDef *uart)
+UARTManager::UARTManager(UART_HandleTypeDef *uart) :
+		droppedMessages(0), droppedBytes(0), discardedMessages(0), blockedWriters(
+				0), abortedTransfers(0), txBytes(0), txBusyTicks(0), rxHead(0), rxResync(0), rxBytes(0), rxOverruns(0), rxErrors(
+				0)
 {
 	this->uart = uart;
-	manager = this;
 	UartLock = 0;
+
+	bool registered = false;
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for (Instance &instance : instances)
+	{
+		if (instance.manager == nullptr || instance.uart == uart)
+		{
+			instance.uart = uart;
+			instance.manager = this;
+			registered = true;
+			break;
+		}
+	}
+	__set_PRIMASK(primask);
+
+	if (!registered)
+	{
+		Error_Handler(); // Raise UART_MAX_INSTANCES
+	}
+}
+
+UARTManager* UARTManager::find(UART_HandleTypeDef *huart)
+{
+	for (const Instance &instance : instances)
+	{
+		if (instance.uart == huart)
+		{
+			return instance.manager;
+		}
+	}
+	return nullptr;
 }
 
 void UARTManager::txComplete(UART_HandleTypeDef *huart)
 {
-	if (manager != nullptr && huart == manager->uart)
+	UARTManager *manager = find(huart);
+	if (manager != nullptr)
 	{
 		osEventFlagsSet(manager->UartLock, 0x01); // clear to send
 	}
 }
 
+void UARTManager::rxEvent(UART_HandleTypeDef *huart, uint16_t position)
+{
+	UARTManager *manager = find(huart);
+	if (manager == nullptr)
+	{
+		return;
+	}
+	// Raised on line idle, half and full buffer, so the DMA is never more than half a buffer ahead
+	const uint16_t received = (uint16_t) (position - manager->rxPosition)
+			% UART_RX_BUFFER_SIZE;
+	manager->rxPosition = position % UART_RX_BUFFER_SIZE;
+	if (received == 0)
+	{
+		return;
+	}
+	manager->rxHead.fetch_add(received, std::memory_order_release);
+	manager->rxBytes.fetch_add(received, std::memory_order_relaxed);
+	osEventFlagsSet(manager->UartLock, 0x02);
+	if (manager->rxCallback != nullptr)
+	{
+		manager->rxCallback(manager, manager->rxCallbackArg);
+	}
+}
+
+void UARTManager::rxError(UART_HandleTypeDef *huart)
+{
+	UARTManager *manager = find(huart);
+	if (manager == nullptr)
+	{
+		return;
+	}
+	const uint32_t error = HAL_UART_GetError(huart);
+	if (error & (HAL_UART_ERROR_ORE | HAL_UART_ERROR_NE | HAL_UART_ERROR_FE))
+	{
+		manager->rxErrors.fetch_add(1, std::memory_order_relaxed);
+	}
+	// The HAL stops reception on errors, restart it at the beginning of the buffer
+	const uint32_t head = (manager->rxHead.load(std::memory_order_relaxed)
+			+ UART_RX_BUFFER_SIZE - 1) & ~(UART_RX_BUFFER_SIZE - 1);
+	manager->rxHead.store(head, std::memory_order_release);
+	manager->rxResync.store(head, std::memory_order_release);
+	manager->rxPosition = 0;
+	HAL_UARTEx_ReceiveToIdle_DMA(huart, manager->rxBuffer, UART_RX_BUFFER_SIZE);
+}
+
+size_t UARTManager::gather(uint8_t *buffer, size_t size)
+{
+	size_t idx = 0;
+	while (idx < size)
+	{
+		// Writers may drop the oldest record, so the tail only moves with interrupts masked
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		size_t length;
+		const uint8_t *data = txRing.peek(&length);
+		const size_t offset = ringOffset;
+		const uint32_t generation = discards;
+		__set_PRIMASK(primask);
+		if (data == nullptr)
+		{
+			break;
+		}
+
+		// A record larger than the space left is split across batches
+		const size_t n = std::min(length - offset, size - idx);
+		memcpy(buffer + idx, data + offset, n);
+
+		primask = __get_PRIMASK();
+		__disable_irq();
+		if (discards == generation)
+		{
+			idx += n;
+			ringOffset += n;
+			if (ringOffset == length)
+			{
+				txRing.pop();
+				ringOffset = 0;
+			}
+		}
+		// Otherwise the record was dropped while it was copied, leave the copy out
+		__set_PRIMASK(primask);
+	}
+	return idx;
+}
+
+bool UARTManager::discardOldest()
+{
+	size_t length = 0;
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	const bool ok = txRing.discard(&length);
+	if (ok)
+	{
+		length -= std::min(length, ringOffset); // Part of it may already be on the wire
+		ringOffset = 0;
+		discards++;
+	}
+	__set_PRIMASK(primask);
+
+	if (ok)
+	{
+		droppedMessages.fetch_add(1, std::memory_order_relaxed);
+		droppedBytes.fetch_add(length, std::memory_order_relaxed);
+		discardedMessages.fetch_add(1, std::memory_order_relaxed);
+	}
+	return ok;
+}
+
 __NO_RETURN void UARTManager::main(void *arg)
 {
 	UARTManager *manager = (UARTManager*) arg;
-	char *msg;
+	uint8_t fill = 0; // Buffer being filled, the other one may be on the wire
+	size_t pending = 0; // Bytes batched in txBuffer[fill]
+	size_t inFlight = 0; // Bytes of the transfer in progress
+	uint32_t batchStart = 0;
+	uint32_t transferStart = 0;
 
 	HAL_UART_RegisterCallback(manager->uart, HAL_UART_TX_COMPLETE_CB_ID,
 			txComplete);
 
 	for (;;)
 	{
-		int32_t flags = osEventFlagsWait(manager->UartLock, 0x01,
-				osFlagsWaitAll | osFlagsNoClear, msgSize > 0 ? 1 * msgSize : 10);
-
-		if(flags < 1 && msgToFree != nullptr)
+		if (pending == 0)
 		{
-			// If this times out (10ms) something is wrong, so abort the request and do the next message
-			HAL_UART_Abort(manager->uart);
-			HAL_UART_Transmit(manager->uart, (uint8_t*) "\r\n", 2, 10); // Add a new line so the next message isn't combined with the failed one
+			batchStart = osKernelGetTickCount();
 		}
+		pending += manager->gather(manager->txBuffer[fill] + pending,
+				UART_TX_BATCH_SIZE - pending);
 
-		if (msgToFree != nullptr)
+		if (inFlight > 0)
 		{
-			vPortFree(msgToFree);
-			msgToFree = nullptr;
-			msgSize = 0;
+			int32_t flags = osEventFlagsWait(manager->UartLock, 0x01,
+					osFlagsWaitAll | osFlagsNoClear, inFlight);
+			if (flags < 1)
+			{
+				// If this times out something is wrong, so abort the request and do the next batch
+				HAL_UART_AbortTransmit(manager->uart); // Leave reception running
+				HAL_UART_Transmit(manager->uart, (uint8_t*) "\r\n", 2, 10); // Add a new line so the next message isn't combined with the failed one
+				manager->abortedTransfers.fetch_add(1, std::memory_order_relaxed);
+				manager->droppedBytes.fetch_add(inFlight, std::memory_order_relaxed);
+			}
+			else
+			{
+				manager->txBytes.fetch_add(inFlight, std::memory_order_relaxed);
+				manager->txBusyTicks.fetch_add(osKernelGetTickCount() - transferStart,
+						std::memory_order_relaxed);
+			}
+			inFlight = 0;
+			continue; // Top the batch up with whatever arrived during the transfer
 		}
-		auto retval = osMessageQueueGet(manager->UARTOutboxHandle, &msg, nullptr, 10);
-		if (retval == osOK)
+
+		const uint32_t waited = osKernelGetTickCount() - batchStart;
+		if (pending == 0
+				|| (pending < UART_TX_BATCH_SIZE && waited < UART_TX_FLUSH_TICKS))
 		{
-			int size = strlen(msg);
-			HAL_UART_Transmit_DMA(manager->uart, (uint8_t*) msg, size);
-			osEventFlagsClear(manager->UartLock, 0x01);
-			msgToFree = msg;
-			msgSize = size;
+			// Nothing worth sending yet, sleep until commit() queues more or the batch is due
+			osEventFlagsWait(manager->UartLock, 0x04, osFlagsWaitAny,
+					(pending == 0) ? osWaitForever : UART_TX_FLUSH_TICKS - waited);
+			continue;
 		}
+
+		osEventFlagsClear(manager->UartLock, 0x01);
+		transferStart = osKernelGetTickCount();
+		HAL_UART_Transmit_DMA(manager->uart, manager->txBuffer[fill], pending);
+		inFlight = pending;
+		pending = 0;
+		fill ^= 1;
 	}
 	osThreadExit();
 }
@@ -86,10 +253,6 @@ void UARTManager::start()
 	ProcessUART_attributes.priority = (osPriority_t) osPriorityNormal;
 	ProcessUART_attributes.stack_size = 2048 * 4;
 
-	/* creation of UARTOutbox */
-	UARTOutboxHandle = osMessageQueueNew(16, sizeof(char*),
-			&UARTOutbox_attributes);
-
 	/* creation of ProcessUART */
 	ProcessUARTHandle = osThreadNew(this->main, (void*) this,
 			&ProcessUART_attributes);
@@ -99,33 +262,242 @@ void UARTManager::print(const char *fmt, ...)
 {
 	va_list args;
 	va_start(args, fmt);
-	size_t strsize = vsnprintf(nullptr, 0, fmt, args) + 1;
-	char *buffer = (char*) pvPortMalloc(strsize);
-	va_end(args);
-	va_start(args, fmt);
-	vsnprintf(buffer, strsize, fmt, args);
+	vprint(fmt, args);
 	va_end(args);
+}
+
+void UARTManager::vprint(const char *format, va_list arg)
+{
+	// Size the message first, so only the space it needs is reserved (and, under
+	// UART_DROP_OLDEST, evicted)
+	va_list sizing;
+	va_copy(sizing, arg);
+	const int needed = vsnprintf(nullptr, 0, format, sizing);
+	va_end(sizing);
+	if (needed < 0)
+	{
+		// Formatting failed, there is nothing valid to send
+		droppedMessages.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	const size_t length = std::min((size_t) needed, (size_t) UART_PRINT_MAX_LENGTH - 1);
 
-	if (osMessageQueuePut(UARTOutboxHandle, &buffer, 0, 0) != osOK)
+	char *buffer = reserve(length + 1); // vsnprintf() always writes a terminator
+	if (buffer == nullptr)
 	{
-		vPortFree(buffer);
+		droppedBytes.fetch_add(needed, std::memory_order_relaxed);
+		return;
 	}
+	const int n = vsnprintf(buffer, length + 1, format, arg);
+	commit(buffer, (n < 0) ? 0 : length);
 }
 
-void UARTManager::vprint(const char *format, va_list arg)
+bool UARTManager::write(const char *data, size_t size, bool urgent)
+{
+	char *buffer = reserve(size, urgent);
+	if (buffer == nullptr)
+	{
+		droppedBytes.fetch_add(size, std::memory_order_relaxed);
+		return false;
+	}
+	memcpy(buffer, data, size);
+	commit(buffer, size);
+	return true;
+}
+
+char* UARTManager::reserve(size_t size, bool urgent)
+{
+	const size_t headroom = urgent ? 0 : UART_TX_URGENT_RESERVE;
+	uint8_t *data = txRing.reserve(size, headroom);
+	if (data != nullptr)
+	{
+		return (char*) data;
+	}
+
+	if (urgent || policy == UART_DROP_OLDEST)
+	{
+		while (data == nullptr && discardOldest())
+		{
+			data = txRing.reserve(size, headroom);
+		}
+	}
+	else if (policy == UART_BLOCK && __get_IPSR() == 0
+			&& osKernelGetState() == osKernelRunning)
+	{
+		blockedWriters.fetch_add(1, std::memory_order_relaxed);
+		const uint32_t start = osKernelGetTickCount();
+		while (data == nullptr && osKernelGetTickCount() - start < blockTimeout)
+		{
+			osDelay(1); // ProcessUART frees space as it batches
+			data = txRing.reserve(size, headroom);
+		}
+	}
+
+	if (data == nullptr)
+	{
+		droppedMessages.fetch_add(1, std::memory_order_relaxed);
+	}
+	return (char*) data;
+}
+
+void UARTManager::commit(char *data, size_t length)
+{
+	txRing.commit((uint8_t*) data, length);
+	if (UartLock != nullptr)
+	{
+		osEventFlagsSet(UartLock, 0x04); // data queued
+	}
+}
+
+void UARTManager::setBackpressure(UARTBackpressure policy, uint32_t timeout)
+{
+	this->policy = policy;
+	blockTimeout = timeout;
+}
+
+uint32_t UARTManager::dropped() const
+{
+	return droppedMessages.load(std::memory_order_relaxed);
+}
+
+void UARTManager::startReceive(UARTRxCallback callback, void *arg)
+{
+	rxCallback = callback;
+	rxCallbackArg = arg;
+
+	HAL_UART_RegisterRxEventCallback(uart, rxEvent);
+	HAL_UART_RegisterCallback(uart, HAL_UART_ERROR_CB_ID, rxError);
+	HAL_UARTEx_ReceiveToIdle_DMA(uart, rxBuffer, UART_RX_BUFFER_SIZE);
+}
+
+bool UARTManager::waitReceive(uint32_t timeout)
+{
+	if (available() == 0)
+	{
+		osEventFlagsWait(UartLock, 0x02, osFlagsWaitAny, timeout);
+	}
+	return available() > 0;
+}
+
+size_t UARTManager::available()
 {
-	size_t strsize = vsnprintf(nullptr, 0, format, arg) + 1;
-	char *buffer = (char*) pvPortMalloc(strsize);
-	vsnprintf(buffer, strsize,format, arg);
+	const uint32_t head = rxHead.load(std::memory_order_acquire);
+	const uint32_t resync = rxResync.load(std::memory_order_relaxed);
+	if ((int32_t) (resync - rxTail) > 0)
+	{
+		rxTail = resync; // Reception was restarted after an error
+	}
+	if (head - rxTail > UART_RX_BUFFER_SIZE)
+	{
+		// The DMA overwrote input that was not read yet
+		rxOverruns.fetch_add(1, std::memory_order_relaxed);
+		rxTail = head;
+	}
+	return head - rxTail;
+}
+
+size_t UARTManager::peek(const char **data)
+{
+	const size_t n = available();
+	const size_t offset = rxTail & (UART_RX_BUFFER_SIZE - 1);
+	*data = (const char*) &rxBuffer[offset];
+	return std::min(n, UART_RX_BUFFER_SIZE - offset);
+}
+
+void UARTManager::consume(size_t size)
+{
+	rxTail += size;
+}
 
-	if (osMessageQueuePut(UARTOutboxHandle, &buffer, 0, 0) != osOK)
+size_t UARTManager::read(char *data, size_t size)
+{
+	size_t idx = 0;
+	const char *chunk;
+	size_t n;
+	while (idx < size && (n = peek(&chunk)) > 0)
 	{
-		vPortFree(buffer);
+		n = std::min(n, size - idx);
+		memcpy(data + idx, chunk, n);
+		consume(n);
+		idx += n;
 	}
+	return idx;
+}
+
+bool UARTManager::nextLine(UARTRxFrame *frame, char delimiter)
+{
+	const size_t n = available();
+	const size_t offset = rxTail & (UART_RX_BUFFER_SIZE - 1);
+	const size_t first = std::min(n, UART_RX_BUFFER_SIZE - offset);
+	const char *buffer = (const char*) rxBuffer;
+
+	size_t size = 0;
+	const char *end = (const char*) memchr(buffer + offset, delimiter, first);
+	if (end != nullptr)
+	{
+		size = end - (buffer + offset) + 1;
+	}
+	else if (n > first
+			&& (end = (const char*) memchr(buffer, delimiter, n - first)) != nullptr)
+	{
+		size = first + (end - buffer) + 1;
+	}
+	else
+	{
+		if (n == UART_RX_BUFFER_SIZE)
+		{
+			// The frame can never complete, drop it
+			rxOverruns.fetch_add(1, std::memory_order_relaxed);
+			consume(n);
+		}
+		return false;
+	}
+
+	frame->data[0] = buffer + offset;
+	frame->length[0] = std::min(size, first);
+	frame->data[1] = buffer;
+	frame->length[1] = size - frame->length[0];
+	frame->size = size;
+	return true;
+}
+
+void UARTManager::release(const UARTRxFrame &frame)
+{
+	consume(frame.size);
+}
+
+UARTStats UARTManager::stats() const
+{
+	UARTStats stats;
+	stats.capacity = txRing.capacity();
+	stats.used = txRing.used();
+	stats.highWater = txRing.highWater();
+	stats.dropped = droppedMessages.load(std::memory_order_relaxed);
+	stats.droppedBytes = droppedBytes.load(std::memory_order_relaxed);
+	stats.discarded = discardedMessages.load(std::memory_order_relaxed);
+	stats.blocked = blockedWriters.load(std::memory_order_relaxed);
+	stats.aborted = abortedTransfers.load(std::memory_order_relaxed);
+	stats.sent = txBytes.load(std::memory_order_relaxed);
+	stats.txBusy = txBusyTicks.load(std::memory_order_relaxed);
+	stats.received = rxBytes.load(std::memory_order_relaxed);
+	stats.rxOverruns = rxOverruns.load(std::memory_order_relaxed);
+	stats.rxErrors = rxErrors.load(std::memory_order_relaxed);
+	return stats;
 }
 
 UARTManager::~UARTManager()
 {
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for (Instance &instance : instances)
+	{
+		if (instance.manager == this)
+		{
+			instance.uart = nullptr;
+			instance.manager = nullptr;
+		}
+	}
+	__set_PRIMASK(primask);
 
 }
 
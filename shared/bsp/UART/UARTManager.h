@@ -12,8 +12,83 @@
 #include <cstdint>
 #include "cmsis_os.h"
 #include <stdarg.h>
+#include <atomic>
 
+#include "Logging/LogRing.h"
 
+// Number of UARTManager instances that can exist at the same time
+#ifndef UART_MAX_INSTANCES
+#define UART_MAX_INSTANCES 4
+#endif
+
+// Size of the lock-free transmit ring used by write() and reserve() (bytes, power of two)
+#ifndef UART_TX_RING_SIZE
+#define UART_TX_RING_SIZE 8192
+#endif
+
+// Longest output of one print()/vprint() call, longer output is cut off (bytes)
+#ifndef UART_PRINT_MAX_LENGTH
+#define UART_PRINT_MAX_LENGTH 1024
+#endif
+
+// Size of each of the two DMA buffers, i.e. the largest batch sent in one transfer (bytes)
+#ifndef UART_TX_BATCH_SIZE
+#define UART_TX_BATCH_SIZE 1024
+#endif
+
+// Ticks a partly filled batch may wait for more data while the line is idle (0 sends right away)
+#ifndef UART_TX_FLUSH_TICKS
+#define UART_TX_FLUSH_TICKS 0
+#endif
+
+// Ring space only urgent output (ERROR/PANIC log lines) may use (bytes)
+#ifndef UART_TX_URGENT_RESERVE
+#define UART_TX_URGENT_RESERVE 1024
+#endif
+
+// Size of the circular DMA receive buffer, also the longest frame nextLine() returns (bytes, power of two)
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 512
+#endif
+
+// What happens to output that does not fit in the transmit ring
+typedef enum
+{
+	UART_DROP_NEWEST, // Drop the new output (default)
+	UART_DROP_OLDEST, // Drop queued output that has not been batched yet
+	UART_BLOCK, // Wait for space up to a timeout, then drop the new output. Drops newest in ISRs
+} UARTBackpressure;
+
+// Transmit statistics, see UARTManager::stats()
+typedef struct
+{
+	size_t capacity; // Ring size in bytes
+	size_t used; // Bytes currently queued or being written
+	size_t highWater; // Largest number of bytes ever queued, including record headers
+	uint32_t dropped; // Messages lost, new ones rejected plus old ones discarded
+	uint32_t droppedBytes; // Bytes lost where the length is known (writes, prints, discarded and aborted data)
+	uint32_t discarded; // Queued messages dropped to make room (included in dropped)
+	uint32_t blocked; // Writers that had to wait for space
+	uint32_t aborted; // Transfers aborted after a DMA timeout
+	uint32_t sent; // Bytes of completed transfers
+	uint32_t txBusy; // Ticks a transfer was on the wire, sent * 10 / txBusy over baud / 1000 is the line use
+	uint32_t received; // Bytes received
+	uint32_t rxOverruns; // Times unread input was overwritten or a frame did not fit the buffer
+	uint32_t rxErrors; // Framing, noise and hardware overrun errors
+} UARTStats;
+
+class UARTManager;
+
+// Called from the receive interrupt whenever new input arrived (line idle, half or full buffer)
+typedef void (*UARTRxCallback)(UARTManager *uart, void *arg);
+
+// Received frame, in two parts if it wraps around the end of the receive buffer
+typedef struct
+{
+	const char *data[2];
+	size_t length[2];
+	size_t size; // Total length including the delimiter, see UARTManager::release()
+} UARTRxFrame;
 
 class UARTManager
 {
@@ -25,28 +100,93 @@ private:
 	osThreadAttr_t ProcessUART_attributes =
 	{ .name = "ProcessUART", };
 
-	/* Definitions for UARTOutbox */
-	osMessageQueueId_t UARTOutboxHandle;
-	const osMessageQueueAttr_t UARTOutbox_attributes =
-	{ .name = "UARTOutbox" };
-
 	osEventFlagsId_t UartLock;
 
+	/* Lock-free transmit ring, filled by write()/print() and drained by ProcessUART */
+	LogRing<UART_TX_RING_SIZE> txRing;
+	size_t ringOffset = 0; // Bytes of the oldest ring record already batched
+	uint32_t discards = 0; // Bumped when a writer drops the oldest record, see gather()
+
+	UARTBackpressure policy = UART_DROP_NEWEST;
+	uint32_t blockTimeout = 0;
+
+	std::atomic<uint32_t> droppedMessages;
+	std::atomic<uint32_t> droppedBytes;
+	std::atomic<uint32_t> discardedMessages;
+	std::atomic<uint32_t> blockedWriters;
+	std::atomic<uint32_t> abortedTransfers;
+	std::atomic<uint32_t> txBytes;
+	std::atomic<uint32_t> txBusyTicks;
+
+	/* Circular DMA receive buffer, the DMA is the producer and the reading thread the consumer */
+	uint8_t rxBuffer[UART_RX_BUFFER_SIZE];
+	uint16_t rxPosition = 0; // Where the DMA writes next, only used by the receive interrupt
+	std::atomic<uint32_t> rxHead; // Bytes received since start
+	std::atomic<uint32_t> rxResync; // Head after the DMA was restarted, older input is lost
+	uint32_t rxTail = 0; // Bytes consumed since start
+	UARTRxCallback rxCallback = nullptr;
+	void *rxCallbackArg = nullptr;
+	std::atomic<uint32_t> rxBytes;
+	std::atomic<uint32_t> rxOverruns;
+	std::atomic<uint32_t> rxErrors;
+
+	static_assert((UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) == 0,
+			"UART_RX_BUFFER_SIZE must be a power of two");
+
+	/* Ping-pong DMA buffers, one is on the wire while ProcessUART fills the other */
+	uint8_t txBuffer[2][UART_TX_BATCH_SIZE];
+
+	size_t gather(uint8_t *buffer, size_t size);
+	bool discardOldest();
+
 	static void main(void *);
 
+	// Returns the instance driving a HAL handle, used by the shared HAL callbacks
+	static UARTManager* find(UART_HandleTypeDef *huart);
+
 	static void txComplete(UART_HandleTypeDef *huart);
+	static void rxEvent(UART_HandleTypeDef *huart, uint16_t position);
+	static void rxError(UART_HandleTypeDef *huart);
 
 public:
 	UARTManager(UART_HandleTypeDef * uart);
 	void start();
+	// Formats into the transmit ring, no heap allocation. Safe to call from ISRs
 	void print(const char *fmt, ...);
 	void vprint( const char * format, va_list arg );
 
+	// Safe to call from ISRs, only blocks with UART_BLOCK. Returns false if the data was dropped.
+	// Urgent data may use the last UART_TX_URGENT_RESERVE bytes and drops older output if needed
+	bool write(const char *data, size_t size, bool urgent = false);
+	// Lets the caller format straight into the transmit ring: reserve() returns nullptr
+	// if the ring is full, commit() queues the first `length` bytes and frees the rest
+	char* reserve(size_t size, bool urgent = false);
+	void commit(char *data, size_t length);
+
+	// Sets what happens when the ring is full, timeout (ticks) only applies to UART_BLOCK
+	void setBackpressure(UARTBackpressure policy, uint32_t timeout = 0);
+	uint32_t dropped() const;
+	UARTStats stats() const;
+
+	// Starts circular DMA reception, the UART's RX DMA channel must be set up in circular mode.
+	// The callback (optional) runs in interrupt context
+	void startReceive(UARTRxCallback callback = nullptr, void *arg = nullptr);
+	// The receive functions below must all be called from the same thread.
+	// Waits until input is available, returns false on timeout
+	bool waitReceive(uint32_t timeout);
+	size_t available();
+	// Returns the received bytes that are contiguous in the buffer without copying them,
+	// e.g. to pass them to CO_GTWA_write(), then call consume() with the number used
+	size_t peek(const char **data);
+	void consume(size_t size);
+	size_t read(char *data, size_t size);
+	// Finds the next frame ending in delimiter without copying it, call release() when done
+	bool nextLine(UARTRxFrame *frame, char delimiter = '\n');
+	void release(const UARTRxFrame &frame);
+
 	virtual ~UARTManager();
-	UARTManager(const UARTManager &other) = default;
-	UARTManager(UARTManager &&other) = default;
-	UARTManager& operator=(const UARTManager &other) = default;
-	UARTManager& operator=(UARTManager &&other) = default;
+	UARTManager(const UARTManager &other) = delete;
+	UARTManager& operator=(const UARTManager &other) = delete;
 };
 
 #endif /* SRC_SHARED_LOGGING_UARTMANAGER_H_ */
@@ -0,0 +1,28 @@
+/*
+ * CO_config.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_TESTS_CANOPENNODE_CO_CONFIG_H_
+#define SRC_SHARED_TESTS_CANOPENNODE_CO_CONFIG_H_
+
+/* Configuration of the host tests, only what the tested modules use. The
+ * application's CO_config.h stays out of the build so every option under
+ * test is enabled. */
+
+#define CO_CONFIG_CRC16_ENABLE 0x01
+#define CO_CONFIG_CRC16_EXTERNAL 0x02
+
+#define CO_CONFIG_FIFO_ENABLE 0x01
+#define CO_CONFIG_FIFO_ALT_READ 0x02
+#define CO_CONFIG_FIFO_CRC16_CCITT 0x04
+#define CO_CONFIG_FIFO_ASCII_COMMANDS 0x08
+#define CO_CONFIG_FIFO_ASCII_DATATYPES 0x10
+
+#define CO_CONFIG_CRC16 (CO_CONFIG_CRC16_ENABLE)
+#define CO_CONFIG_FIFO (CO_CONFIG_FIFO_ENABLE | CO_CONFIG_FIFO_ALT_READ \
+		| CO_CONFIG_FIFO_CRC16_CCITT | CO_CONFIG_FIFO_ASCII_COMMANDS)
+
+#endif /* SRC_SHARED_TESTS_CANOPENNODE_CO_CONFIG_H_ */
@@ -0,0 +1,191 @@
+/*
+ * CO_ODinterface_test.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+/* Builds synthetic object dictionaries of several sizes (the communication
+ * profile plus random manufacturer and device profile entries), indexes them
+ * with OD_buildIndex() and checks OD_find() for every index 0..0xFFFF against
+ * a plain binary search over the list. With "bench" it times OD_find() with
+ * and without the index across the OD sizes instead, for lookups that mostly
+ * hit. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "301/CO_ODinterface.h"
+
+#define OD_ENTRIES_MAX 2000
+#define LOOKUPS (1UL << 16)
+#define BENCH_ROUNDS 200
+
+static OD_entry_t list[OD_ENTRIES_MAX];
+static OD_index_t odIndex;
+static uint16_t lookups[LOOKUPS];
+
+static const uint16_t commProfile[] = { 0x1000, 0x1001, 0x1003, 0x1005, 0x1006, 0x1007, 0x1008,
+		0x1009, 0x100A, 0x1010, 0x1011, 0x1012, 0x1014, 0x1015, 0x1016, 0x1017, 0x1018, 0x1019,
+		0x1200, 0x1280, 0x1400, 0x1401, 0x1402, 0x1403, 0x1600, 0x1601, 0x1602, 0x1603, 0x1800,
+		0x1801, 0x1802, 0x1803, 0x1A00, 0x1A01, 0x1A02, 0x1A03, 0x1F80 };
+static const uint16_t sizes[] = { 16, 64, 256, 512, 1024, 2000 };
+
+static double seconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+static int compareIndex(const void *a, const void *b)
+{
+	return (int) ((const OD_entry_t*) a)->index - (int) ((const OD_entry_t*) b)->index;
+}
+
+static bool_t contains(uint16_t size, uint16_t index)
+{
+	for (uint16_t i = 0; i < size; i++)
+	{
+		if (list[i].index == index)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Fills list with size sorted entries and lookups with 80 % existing indexes */
+static void buildOD(uint16_t size)
+{
+	uint16_t n = 0;
+
+	memset(list, 0, sizeof(list));
+	for (size_t i = 0; i < sizeof(commProfile) / sizeof(commProfile[0]) && n < size; i++)
+	{
+		list[n++].index = commProfile[i];
+	}
+	while (n < size)
+	{
+		const uint16_t index = (rand() % 4 == 0) ? (uint16_t) (0x6000 + rand() % 0x400)
+				: (uint16_t) (0x2000 + rand() % ((size < 300) ? 0x200 : 0x800));
+		if (!contains(n, index))
+		{
+			list[n++].index = index;
+		}
+	}
+	qsort(list, size, sizeof(list[0]), compareIndex);
+
+	for (unsigned long i = 0; i < LOOKUPS; i++)
+	{
+		lookups[i] = (rand() % 5 != 0) ? list[rand() % size].index : (uint16_t) rand();
+	}
+}
+
+static OD_entry_t *binarySearch(uint16_t size, uint16_t index)
+{
+	int min = 0, max = size - 1;
+
+	while (min <= max)
+	{
+		const int cur = (min + max) / 2;
+		if (list[cur].index == index)
+		{
+			return &list[cur];
+		}
+		if (list[cur].index < index)
+		{
+			min = cur + 1;
+		}
+		else
+		{
+			max = cur - 1;
+		}
+	}
+	return NULL;
+}
+
+static int check(void)
+{
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		OD_t od = { sizes[s], list, NULL };
+		OD_t odIndexed = od;
+
+		buildOD(sizes[s]);
+		if (!OD_buildIndex(&odIndexed, &odIndex))
+		{
+			printf("OD_find: %u entries need more than %d index pages\n", sizes[s], OD_INDEX_PAGES);
+			return 1;
+		}
+		for (uint32_t index = 0; index <= 0xFFFF; index++)
+		{
+			const OD_entry_t *expected = binarySearch(sizes[s], (uint16_t) index);
+			if (OD_find(&od, (uint16_t) index) != expected
+					|| OD_find(&odIndexed, (uint16_t) index) != expected)
+			{
+				printf("OD_find: %u entries, index %04X: binary search %p, index %p, expected %p\n",
+						sizes[s], (unsigned) index, (void*) OD_find(&od, (uint16_t) index),
+						(void*) OD_find(&odIndexed, (uint16_t) index), (const void*) expected);
+				return 1;
+			}
+		}
+	}
+	printf("OD_find: matches binary search for every index, %zu OD sizes\n",
+			sizeof(sizes) / sizeof(sizes[0]));
+	return 0;
+}
+
+static void bench(void)
+{
+	printf("OD_find: ns per lookup, 80 %% hits\n");
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		OD_t od = { sizes[s], list, NULL };
+		OD_t odIndexed = od;
+		double ns[2];
+		int pages = 0;
+		volatile uintptr_t sink = 0;
+
+		buildOD(sizes[s]);
+		if (!OD_buildIndex(&odIndexed, &odIndex))
+		{
+			printf("  entries %4u: more than %d index pages\n", sizes[s], OD_INDEX_PAGES);
+			continue;
+		}
+		for (int i = 0; i < 256; i++)
+		{
+			pages += odIndex.page[i] != OD_INDEX_NONE;
+		}
+
+		for (int indexed = 0; indexed < 2; indexed++)
+		{
+			OD_t *o = indexed ? &odIndexed : &od;
+			const double start = seconds();
+
+			for (int round = 0; round < BENCH_ROUNDS; round++)
+			{
+				for (unsigned long i = 0; i < LOOKUPS; i++)
+				{
+					sink += (uintptr_t) OD_find(o, lookups[i]);
+				}
+			}
+			ns[indexed] = (seconds() - start) / ((double) BENCH_ROUNDS * LOOKUPS) * 1e9;
+		}
+		printf("  entries %4u, %2d pages (%4zu B): binary search %5.1f  index %5.1f  x%.1f\n",
+				sizes[s], pages, 256 + pages * sizeof(OD_indexPage_t), ns[0], ns[1], ns[0] / ns[1]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	srand(5);
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		bench();
+		return 0;
+	}
+	return check();
+}
@@ -0,0 +1,240 @@
+/*
+ * FIFO circular buffer
+ *
+ * @file        CO_fifo_ref.c
+ * @ingroup     CO_CANopen_309_fifo
+ * @author      Janez Paternoster
+ * @copyright   2020 Janez Paternoster
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* CO_fifo_init() to CO_fifo_altRead() as they were before data was copied in
+ * contiguous spans, one byte per iteration. Kept as the reference the host
+ * test compares the current implementation against. */
+
+#include <string.h>
+
+#include "CO_fifo_ref.h"
+#include "301/crc16-ccitt.h"
+
+#if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ASCII_COMMANDS
+/* Non-graphical character for command delimiter */
+#define DELIM_COMMAND ((uint8_t)'\n')
+#endif
+
+/******************************************************************************/
+void CO_fifo_ref_init(CO_fifo_t *fifo, uint8_t *buf, size_t bufSize) {
+
+    if (fifo == NULL || buf == NULL || bufSize < 2) {
+        return;
+    }
+
+    fifo->readPtr = 0;
+    fifo->writePtr = 0;
+    fifo->buf = buf;
+    fifo->bufSize = bufSize;
+
+    return;
+}
+
+
+/* Circular FIFO buffer example for fifo->bufSize = 7 (usable size = 6): ******
+ *                                                                            *
+ *   0      *            *             *            *                         *
+ *   1    rp==wp      readPtr      writePtr         *                         *
+ *   2      *            *             *            *                         *
+ *   3      *            *             *        writePtr                      *
+ *   4      *        writePtr       readPtr      readPtr                      *
+ *   5      *            *             *            *                         *
+ *   6      *            *             *            *                         *
+ *                                                                            *
+ *        empty       3 bytes       4 bytes       buffer                      *
+ *        buffer      in buff       in buff       full                        *
+ ******************************************************************************/
+size_t CO_fifo_ref_write(CO_fifo_t *fifo,
+                     const uint8_t *buf,
+                     size_t count,
+                     uint16_t *crc)
+{
+    size_t i;
+    uint8_t *bufDest;
+
+    if (fifo == NULL || fifo->buf == NULL || buf == NULL) {
+        return 0;
+    }
+
+    bufDest = &fifo->buf[fifo->writePtr];
+    for (i = count; i > 0; i--) {
+        size_t writePtrNext = fifo->writePtr + 1;
+
+        /* is circular buffer full */
+        if (writePtrNext == fifo->readPtr ||
+            (writePtrNext == fifo->bufSize && fifo->readPtr == 0)) {
+            break;
+        }
+
+        *bufDest = *buf;
+
+#if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_CRC16_CCITT
+        if (crc != NULL) {
+            crc16_ccitt_single(crc, *buf);
+        }
+#endif
+
+        /* increment variables */
+        if (writePtrNext == fifo->bufSize) {
+            fifo->writePtr = 0;
+            bufDest = &fifo->buf[0];
+        }
+        else {
+            fifo->writePtr++;
+            bufDest++;
+        }
+        buf++;
+    }
+
+    return count - i;
+}
+
+
+/******************************************************************************/
+size_t CO_fifo_ref_read(CO_fifo_t *fifo, uint8_t *buf, size_t count, bool_t *eof) {
+    size_t i;
+    const uint8_t *bufSrc;
+
+    if (eof != NULL) {
+        *eof = false;
+    }
+    if (fifo == NULL || buf == NULL || fifo->readPtr == fifo->writePtr) {
+        return 0;
+    }
+
+    bufSrc = &fifo->buf[fifo->readPtr];
+    for (i = count; i > 0; ) {
+        const uint8_t c = *bufSrc;
+
+        /* is circular buffer empty */
+        if (fifo->readPtr == fifo->writePtr) {
+            break;
+        }
+
+        *(buf++) = c;
+
+        /* increment variables */
+        if (++fifo->readPtr == fifo->bufSize) {
+            fifo->readPtr = 0;
+            bufSrc = &fifo->buf[0];
+        }
+        else {
+            bufSrc++;
+        }
+        i--;
+
+#if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ASCII_COMMANDS
+        /* is delimiter? */
+        if (eof != NULL && c == DELIM_COMMAND) {
+            *eof = true;
+            break;
+        }
+#endif
+    }
+
+    return count - i;
+}
+
+
+#if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ALT_READ
+/******************************************************************************/
+size_t CO_fifo_ref_altBegin(CO_fifo_t *fifo, size_t offset) {
+    size_t i;
+
+    if (fifo == NULL) {
+        return 0;
+    }
+
+    fifo->altReadPtr = fifo->readPtr;
+    for (i = offset; i > 0; i--) {
+        /* is circular buffer empty */
+        if (fifo->altReadPtr == fifo->writePtr) {
+            break;
+        }
+
+        /* increment variable */
+        if (++fifo->altReadPtr == fifo->bufSize) {
+            fifo->altReadPtr = 0;
+        }
+    }
+
+    return offset - i;
+}
+
+void CO_fifo_ref_altFinish(CO_fifo_t *fifo, uint16_t *crc) {
+
+    if (fifo == NULL) {
+        return;
+    }
+
+    if (crc == NULL) {
+        fifo->readPtr = fifo->altReadPtr;
+    }
+    else {
+        const uint8_t *bufSrc = &fifo->buf[fifo->readPtr];
+        while (fifo->readPtr != fifo->altReadPtr) {
+#if (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_CRC16_CCITT
+            crc16_ccitt_single(crc, *bufSrc);
+#endif
+            /* increment variable */
+            if (++fifo->readPtr == fifo->bufSize) {
+                fifo->readPtr = 0;
+                bufSrc = &fifo->buf[0];
+            }
+            else {
+                bufSrc++;
+            }
+        }
+    }
+}
+
+size_t CO_fifo_ref_altRead(CO_fifo_t *fifo, uint8_t *buf, size_t count) {
+    size_t i;
+    const uint8_t *bufSrc;
+
+    bufSrc = &fifo->buf[fifo->altReadPtr];
+    for (i = count; i > 0; i--) {
+        const uint8_t c = *bufSrc;
+
+        /* is there no more data */
+        if (fifo->altReadPtr == fifo->writePtr) {
+            break;
+        }
+
+        *(buf++) = c;
+
+        /* increment variables */
+        if (++fifo->altReadPtr == fifo->bufSize) {
+            fifo->altReadPtr = 0;
+            bufSrc = &fifo->buf[0];
+        }
+        else {
+            bufSrc++;
+        }
+    }
+
+    return count - i;
+}
+#endif /* (CO_CONFIG_FIFO) & CO_CONFIG_FIFO_ALT_READ */
@@ -0,0 +1,21 @@
+/*
+ * CO_fifo_ref.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+#ifndef SRC_SHARED_TESTS_CO_FIFO_REF_H_
+#define SRC_SHARED_TESTS_CO_FIFO_REF_H_
+
+#include "301/CO_fifo.h"
+
+/* Byte-wise reference of the CO_fifo functions of the same name */
+void CO_fifo_ref_init(CO_fifo_t *fifo, uint8_t *buf, size_t bufSize);
+size_t CO_fifo_ref_write(CO_fifo_t *fifo, const uint8_t *buf, size_t count, uint16_t *crc);
+size_t CO_fifo_ref_read(CO_fifo_t *fifo, uint8_t *buf, size_t count, bool_t *eof);
+size_t CO_fifo_ref_altBegin(CO_fifo_t *fifo, size_t offset);
+void CO_fifo_ref_altFinish(CO_fifo_t *fifo, uint16_t *crc);
+size_t CO_fifo_ref_altRead(CO_fifo_t *fifo, uint8_t *buf, size_t count);
+
+#endif /* SRC_SHARED_TESTS_CO_FIFO_REF_H_ */
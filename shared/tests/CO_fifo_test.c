@@ -0,0 +1,171 @@
+/*
+ * CO_fifo_test.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+/* Runs random write, read and alternate read sequences on CO_fifo and on the
+ * byte-wise reference in CO_fifo_ref.c, with random buffer sizes, delimiters
+ * and CRCs. Return values, pointers, buffer contents, eof and CRC must match
+ * after every call. With "bench" it measures write-then-drain throughput of
+ * both implementations instead. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CO_fifo_ref.h"
+
+#define FUZZ_ROUNDS 2000
+#define FUZZ_OPS 3000
+#define FUZZ_BUF_MAX 42
+#define FUZZ_COUNT_MAX 50
+#define BENCH_BYTES (64UL << 20)
+
+static double seconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+static int fuzz(void)
+{
+	unsigned long ops = 0;
+
+	srand(7);
+	for (int round = 0; round < FUZZ_ROUNDS; round++)
+	{
+		const size_t bufSize = 2 + (size_t) rand() % (FUZZ_BUF_MAX - 1);
+		uint8_t buf[FUZZ_BUF_MAX + 1], bufRef[FUZZ_BUF_MAX + 1];
+		CO_fifo_t fifo, fifoRef;
+		uint16_t crc = 0, crcRef = 0;
+		bool_t alt = false;
+
+		memset(&fifo, 0, sizeof(fifo));
+		memset(&fifoRef, 0, sizeof(fifoRef));
+		CO_fifo_init(&fifo, buf, bufSize);
+		CO_fifo_ref_init(&fifoRef, bufRef, bufSize);
+
+		for (int k = 0; k < FUZZ_OPS; k++)
+		{
+			uint8_t in[FUZZ_COUNT_MAX], out[FUZZ_COUNT_MAX], outRef[FUZZ_COUNT_MAX];
+			const size_t count = (size_t) rand() % FUZZ_COUNT_MAX;
+			const bool_t useCrc = rand() % 2;
+			bool_t eof = false, eofRef = false;
+			size_t ret = 0, retRef = 0;
+			int op = rand() % 6;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				in[i] = (rand() % 6 == 0) ? '\n' : (uint8_t) rand();
+			}
+			memset(out, 0, sizeof(out));
+			memset(outRef, 0, sizeof(outRef));
+
+			/* The alternate read functions are only valid between altBegin and altFinish */
+			if (!alt && (op == 4 || op == 5))
+			{
+				op = 3;
+			}
+			if (alt && op == 2)
+			{
+				op = 4;
+			}
+			switch (op)
+			{
+			case 0:
+			case 1:
+				ret = CO_fifo_write(&fifo, in, count, useCrc ? &crc : NULL);
+				retRef = CO_fifo_ref_write(&fifoRef, in, count, useCrc ? &crcRef : NULL);
+				break;
+			case 2:
+				ret = CO_fifo_read(&fifo, out, count, useCrc ? &eof : NULL);
+				retRef = CO_fifo_ref_read(&fifoRef, outRef, count, useCrc ? &eofRef : NULL);
+				break;
+			case 3:
+				ret = CO_fifo_altBegin(&fifo, count);
+				retRef = CO_fifo_ref_altBegin(&fifoRef, count);
+				alt = true;
+				break;
+			case 4:
+				ret = CO_fifo_altRead(&fifo, out, count);
+				retRef = CO_fifo_ref_altRead(&fifoRef, outRef, count);
+				break;
+			default:
+				CO_fifo_altFinish(&fifo, useCrc ? &crc : NULL);
+				CO_fifo_ref_altFinish(&fifoRef, useCrc ? &crcRef : NULL);
+				alt = false;
+				break;
+			}
+			ops++;
+
+			if (ret != retRef || eof != eofRef || crc != crcRef
+					|| memcmp(out, outRef, sizeof(out)) != 0
+					|| fifo.readPtr != fifoRef.readPtr || fifo.writePtr != fifoRef.writePtr
+					|| fifo.altReadPtr != fifoRef.altReadPtr
+					|| memcmp(buf, bufRef, bufSize) != 0)
+			{
+				printf("CO_fifo: mismatch in round %d, call %d, op %d: %zu, reference %zu\n",
+						round, k, op, ret, retRef);
+				return 1;
+			}
+		}
+	}
+	printf("CO_fifo: matches the reference over %lu calls\n", ops);
+	return 0;
+}
+
+static void bench(void)
+{
+	static uint8_t buf[1024], src[1024], dst[1024];
+	static const size_t chunks[] = { 7, 64, 889 };
+	static const char *const modes[] = { "plain", "crc on write", "read with eof" };
+
+	printf("CO_fifo: 1 KiB FIFO, write then drain (MB/s)\n");
+	for (int mode = 0; mode < 3; mode++)
+	{
+		for (size_t i = 0; i < sizeof(src); i++)
+		{
+			src[i] = (mode == 2 && i % 64 == 63) ? '\n' : (uint8_t) ('a' + i % 26);
+		}
+		for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+		{
+			double rate[2];
+			for (int ref = 0; ref < 2; ref++)
+			{
+				CO_fifo_t fifo;
+				uint16_t crc = 0;
+				bool_t eof;
+				unsigned long total = 0;
+				const double start = seconds();
+
+				(ref ? CO_fifo_ref_init : CO_fifo_init)(&fifo, buf, sizeof(buf));
+				while (total < BENCH_BYTES)
+				{
+					total += (ref ? CO_fifo_ref_write : CO_fifo_write)(&fifo, src, chunks[c],
+							(mode == 1) ? &crc : NULL);
+					while ((ref ? CO_fifo_ref_read : CO_fifo_read)(&fifo, dst, sizeof(dst),
+							(mode == 2) ? &eof : NULL) > 0)
+					{
+					}
+				}
+				rate[ref] = (double) total / (1 << 20) / (seconds() - start);
+			}
+			printf("  %-13s chunk %4zu: reference %8.1f  current %8.1f  x%.1f\n", modes[mode],
+					chunks[c], rate[1], rate[0], rate[0] / rate[1]);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		bench();
+		return 0;
+	}
+	return fuzz();
+}
@@ -0,0 +1,123 @@
+/*
+ * crc16_test.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: reedt
+ */
+
+/* Compares crc16_ccitt_sw(), built with the CO_CONFIG_CRC16_SLICES of this
+ * binary, against a bitwise reference on random blocks, alignments, lengths
+ * and initial values, and checks the standard check value. With "bench" it
+ * measures throughput of both for several block sizes instead. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "301/crc16-ccitt.h"
+
+#define FUZZ_CALLS 200000
+#define FUZZ_LONG_CALLS 1000
+#define FUZZ_SHORT_MAX 300
+#define ALIGN_MAX 64
+#define BUF_SIZE 70000
+#define BENCH_BYTES (128UL << 20)
+
+static uint8_t buf[BUF_SIZE];
+
+static double seconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+/* One bit at a time, polynomial 0x1021, MSB first */
+static uint16_t crc16_ref(const uint8_t block[], size_t blockLength, uint16_t crc)
+{
+	for (size_t i = 0; i < blockLength; i++)
+	{
+		crc ^= (uint16_t) (block[i] << 8);
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static int fuzz(void)
+{
+	static const uint8_t check[] = "123456789";
+	const uint16_t checkCrc = crc16_ccitt_sw(check, sizeof(check) - 1, 0xFFFF);
+
+	if (checkCrc != 0x29B1)
+	{
+		printf("crc16 (%d slices): check value %04X, expected 29B1\n", CO_CONFIG_CRC16_SLICES,
+				checkCrc);
+		return 1;
+	}
+
+	for (int k = 0; k < FUZZ_CALLS; k++)
+	{
+		const size_t offset = (size_t) rand() % ALIGN_MAX;
+		const size_t len = (size_t) rand()
+				% ((k < FUZZ_LONG_CALLS) ? (BUF_SIZE - ALIGN_MAX) : FUZZ_SHORT_MAX);
+		const uint16_t init = (uint16_t) rand();
+		const uint16_t crc = crc16_ccitt_sw(buf + offset, len, init);
+		const uint16_t crcRef = crc16_ref(buf + offset, len, init);
+
+		if (crc != crcRef)
+		{
+			printf("crc16 (%d slices): offset %zu, length %zu, init %04X: %04X, reference %04X\n",
+					CO_CONFIG_CRC16_SLICES, offset, len, init, crc, crcRef);
+			return 1;
+		}
+	}
+	printf("crc16 (%d slices): matches the reference over %d blocks\n", CO_CONFIG_CRC16_SLICES,
+			FUZZ_CALLS);
+	return 0;
+}
+
+static void bench(void)
+{
+	static const size_t sizes[] = { 7, 64, 889, 4096 };
+
+	printf("crc16 (%d slices): MB/s\n", CO_CONFIG_CRC16_SLICES);
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		double rate[2];
+		for (int ref = 0; ref < 2; ref++)
+		{
+			/* The bitwise reference is much slower, give it less data */
+			const unsigned long iterations = (ref ? BENCH_BYTES / 16 : BENCH_BYTES) / sizes[s];
+			volatile uint16_t crc = 0;
+			const double start = seconds();
+
+			for (unsigned long i = 0; i < iterations; i++)
+			{
+				crc = (ref ? crc16_ref : crc16_ccitt_sw)(buf + (i % ALIGN_MAX), sizes[s], crc);
+			}
+			rate[ref] = (double) iterations * sizes[s] / (1 << 20) / (seconds() - start);
+		}
+		printf("  block %4zu: reference %8.1f  current %8.1f  x%.1f\n", sizes[s], rate[1], rate[0],
+				rate[0] / rate[1]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	srand(1);
+	for (size_t i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = (uint8_t) rand();
+	}
+
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		bench();
+		return 0;
+	}
+	return fuzz();
+}